@@ -1,24 +1,93 @@
 #include <SDL2/SDL.h>
 #include "SDL_ttf.h"
+// Assets compiled into the binary, generated by embed_assets.py; without it every asset is read from disk
+#if __has_include("embedded_assets.h")
+#include "embedded_assets.h"
+#else
+struct EmbeddedAsset {
+    const char* name;
+    const unsigned char* data;
+    size_t size;
+};
+constexpr EmbeddedAsset embeddedAssets[] = { { nullptr, nullptr, 0 } };
+#endif
 #include <iostream>
 #include <vector>
 #include <ctime>
 #include <cstdlib>
 #include <string>
-
-// Screen dimension constants
+#include <algorithm>
+#include <bitset>
+#include <map>
+#include <random>
+#include <utility>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+// Screen dimension constants (logical size; the renderer scales it to the window)
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
 const int SNAKE_SIZE = 25;
 const int OBSTACLE_SIZE = 50; // New obstacle size
 
+// Grid dimension constants (in snake cells)
+const int GRID_COLS = SCREEN_WIDTH / SNAKE_SIZE;
+const int GRID_ROWS = SCREEN_HEIGHT / SNAKE_SIZE;
+const int FONT_SIZE = 24; // Font point size at 1:1 pixel scale
+const char* const FONT_ASSET = "font.ttf"; // Looked up like any other asset before the system fonts below
+const char* const SYSTEM_FONT_PATHS[] = {
+    "/Library/Fonts/Arial Unicode.ttf",
+    "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+    "/usr/share/fonts/dejavu/DejaVuSans.ttf",
+    "C:/Windows/Fonts/arial.ttf",
+};
+const Uint32 TIMER_RESOLUTION_MS = 10; // Game time covered by one timer wheel slot
+const int TIMER_WHEEL_BITS = 6;         // Each wheel level has 1 << TIMER_WHEEL_BITS slots
+const int TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_BITS;
+const int TIMER_WHEEL_LEVELS = 4;       // Covers 10ms * 64^4, about 46 hours of game time
+const int CAPTURE_BUFFER_COUNT = 8; // Frames that may wait for the encoder before new ones are dropped
+const int CAPTURE_FPS = 30;         // Fixed frame rate of recordings, independent of the game loop's pace
+const int AUDIO_FREQUENCY = 48000;    // Mixer sample rate; every sound is resampled to it once at load time
+const int AUDIO_BUFFER_SAMPLES = 256; // Samples per callback, about 5 ms at 48 kHz
+const int AUDIO_VOICE_COUNT = 16;     // Sounds that can play at once
+const int AUDIO_QUEUE_SIZE = 64;      // Pending play commands; must be a power of two
+const int HASH_CHECKPOINT_INTERVAL = 60; // Simulation ticks between state hash checkpoints
+const int DEFAULT_OBSTACLE_DENSITY = 2; // Percent of obstacle slots filled (2% of 192 = 3 stones)
+const int MAX_OBSTACLE_DENSITY = 100;   // Accepted --density range is 0 to this; see generateLevelLayout for the real cap
+
 // Direction enum
 enum Direction { UP, DOWN, LEFT, RIGHT };
 
+// Enemy behavior enum (AVOID is not assigned by any level yet and is kept for later use)
+enum EnemyBehavior { WANDER, CHASE, GUARD_FOOD, AVOID };
+
+// Timed game event enum
+enum TimerEventType { BANANA_EXPIRED, LEVEL_UP_FINISHED, COUNTDOWN_FINISHED, COUNTDOWN_BEEP, RANDOM_SNAKE_MOVE };
+
+// Sound effect enum
+enum SoundEffect { SOUND_EAT_APPLE, SOUND_EAT_BANANA, SOUND_LEVEL_UP, SOUND_COLLISION, SOUND_COUNTDOWN, SOUND_COUNT };
+
+// Kinds of cell content in the state hash
+enum HashPiece { PLAYER_CELL, RANDOM_SNAKE_CELL, OBSTACLE_CELL, FOOD_CELL, BANANA_CELL, HASH_PIECE_COUNT };
+
 // Game state enum
 enum GameState { MENU, PLAYING, GAME_OVER, PAUSED, LEVEL_UP, COUNTDOWN };
 
 
+// One bit per grid cell, row-major (index = row * GRID_COLS + col)
+typedef std::bitset<GRID_COLS * GRID_ROWS> CellGrid;
+
+// Function to convert a pixel position to its grid cell index
+inline int cellIndex(int x, int y) {
+    return (y / SNAKE_SIZE) * GRID_COLS + (x / SNAKE_SIZE);
+}
+
 // Snake segment structure
 struct SnakeSegment {
     int x, y;
@@ -32,8 +101,15 @@ struct Color {
 struct RandomSnake {
     std::vector<SnakeSegment> segments;
     Direction direction;
-    Uint32 lastMoveTime;
-    int moveInterval;
+    int moveInterval; // Game time between movements in milliseconds
+    EnemyBehavior behavior;
+};
+
+// BFS distance field to a target cell, shared by every random snake that needs it
+struct DistanceField {
+    std::vector<int> distance; // Steps from each cell to the target, -1 if unreachable
+    CellGrid blocked;          // Obstacle cells the field was computed against
+    int targetIndex = -1;      // Target cell the field was computed for, -1 if never computed
 };
 
 SDL_Texture* backgroundTexture = nullptr;
@@ -44,6 +120,123 @@ SDL_Texture* startBackgroundTexture = nullptr; // New start background texture
 SDL_Texture* stoneTexture = nullptr; // New stone texture
 SDL_Texture* bananaTexture = nullptr; // New banana texture
 
+// State of the framebuffer rendering path: the playfield is drawn on the CPU straight into the locked
+// pixels of a streaming texture once per frame, instead of one renderer call per rect
+struct Framebuffer {
+    SDL_Texture* texture = nullptr;    // Streaming ARGB8888 texture of SCREEN_WIDTH x SCREEN_HEIGHT
+    Uint32* pixels = nullptr;          // Locked texture pixels while a frame is drawn, ARGB8888
+    int pitch = 0;                     // Pixels per row of the locked texture
+    std::vector<Uint32> background;    // background.bmp scaled to the screen
+    std::vector<Uint32> appleSprite;   // apple.bmp scaled to SNAKE_SIZE
+    std::vector<Uint32> bananaSprite;  // banana.bmp scaled to SNAKE_SIZE
+    std::vector<Uint32> stoneSprite;   // stone.bmp scaled to OBSTACLE_SIZE
+};
+
+// Event delivered by the timer wheel when its timer expires
+struct TimerEvent {
+    TimerEventType type;
+    int data; // Event specific, e.g. the index of the random snake to move
+};
+
+// Handle to a scheduled timer; stays safe to cancel or query after the timer fired
+struct TimerHandle {
+    int index = -1;
+    Uint32 generation = 0;
+};
+
+// Hierarchical timer wheel driven by game time. Each level has TIMER_WHEEL_SLOTS slots, and a slot on
+// level n spans TIMER_WHEEL_SLOTS^n slots of the level below; timers move down a level as their expiry
+// approaches. Scheduling and cancelling are O(1), and advancing costs O(elapsed slots + fired timers)
+// however many timers are pending. Slots are circular lists threaded through the node pool, whose first
+// TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS nodes are the list heads.
+struct TimerWheel {
+    struct Node {
+        TimerEvent event;
+        Uint32 expires;    // In TIMER_RESOLUTION_MS units
+        Uint32 generation; // Bumped whenever the node is released, invalidating old handles
+        int prev, next;
+        bool pending;
+    };
+    std::vector<Node> nodes;
+    std::vector<int> freeNodes;
+    Uint32 now = 0; // Current time in TIMER_RESOLUTION_MS units
+};
+
+// Render timing accumulated by the frame loop and printed periodically
+struct FrameStats {
+    Uint64 renderTicks = 0; // Performance counter ticks spent rendering
+    int frames = 0;
+    Uint64 captureTicks = 0; // Performance counter ticks the main thread spent capturing frames
+    int capturedFrames = 0;
+    int droppedFrames = 0;   // Frames skipped because the encoder fell behind
+};
+
+// A captured frame waiting for the encoder, and the number of stream frames it fills
+struct QueuedFrame {
+    int buffer;
+    int repeats;
+};
+
+// Gameplay recording: presented frames are read back into a fixed pool of buffers and written as a
+// YUV4MPEG2 (Y4M) stream by a background encoder thread, so the game loop never waits on the disk.
+// The stream runs at CAPTURE_FPS of wall-clock time: a presented frame is repeated to fill the stream
+// frames since the previous capture, and skipped when the next stream frame is not due yet.
+struct VideoCapture {
+    bool active = false;
+    std::ofstream file;
+    std::thread encoder;
+    std::mutex mutex;
+    std::condition_variable frameReady;
+    std::vector<std::vector<Uint8>> buffers; // RGB24 frames, width * height * 3 bytes each
+    std::vector<int> freeBuffers;            // Buffers the main thread may fill
+    std::deque<QueuedFrame> queuedFrames;    // Filled buffers waiting for the encoder, oldest first
+    bool stopping = false;
+    int width = 0, height = 0;
+    Uint32 startTicks = 0;   // SDL_GetTicks() when recording started
+    Uint64 streamFrames = 0; // Stream frames queued so far
+};
+
+// Request from the game thread to start a sound
+struct AudioCommand {
+    SoundEffect sound;
+    float volume;
+};
+
+// One playing sound in the mixer
+struct AudioVoice {
+    const float* samples = nullptr; // nullptr when the voice is free
+    size_t length = 0;
+    size_t position = 0;
+    float volume = 1.0f;
+};
+
+// Sound mixer fed by the SDL audio callback. All sounds are decoded and resampled to mono float at
+// AUDIO_FREQUENCY up front. The game thread posts commands through a single-producer/single-consumer
+// ring, and the callback mixes a fixed pool of voices, so the callback never allocates or locks.
+struct AudioEngine {
+    SDL_AudioDeviceID device = 0; // 0 when audio is unavailable
+    std::vector<float> sounds[SOUND_COUNT];
+    AudioCommand queue[AUDIO_QUEUE_SIZE];
+    std::atomic<Uint32> queueWrite{0}; // Only advanced by the game thread
+    std::atomic<Uint32> queueRead{0};  // Only advanced by the audio callback
+    AudioVoice voices[AUDIO_VOICE_COUNT];
+};
+
+Framebuffer framebuffer;
+
+// Zobrist keys for the state hash: one random key per cell content and per direction. They come from a
+// fixed-seed generator so every build and machine hashes the same state to the same value.
+Uint64 cellHashKeys[HASH_PIECE_COUNT][GRID_COLS * GRID_ROWS];
+Uint64 directionHashKeys[4];
+
+// Directories searched for assets that override the embedded copies (--assets and SNAKE_ASSET_PATH)
+std::vector<std::string> assetOverridePaths;
+// Directories searched for assets that are not embedded (the executable's directory, then the working directory)
+std::vector<std::string> assetSearchPaths;
+
+// Output pixels per logical pixel; the font is opened at this scale so text stays sharp on high-DPI displays
+float fontScale = 1.0f;
+
 Color startColor = {0, 204, 0, 255}; // Green
 Color endColor = {0, 102, 0, 255};   // Darker Green
 
@@ -61,8 +254,135 @@ inline int customMax(int a, int b) {
     return (a > b) ? a : b;
 }
 
+// Function to set up the asset search paths; the configured ones are checked before the embedded assets
+void initAssetPaths(const std::vector<std::string>& configuredPaths) {
+#ifdef _WIN32
+    const char separator = ';';
+#else
+    const char separator = ':';
+#endif
+    assetOverridePaths = configuredPaths;
+    if (const char* environmentPaths = SDL_getenv("SNAKE_ASSET_PATH")) {
+        std::string paths = environmentPaths;
+        size_t start = 0;
+        while (start <= paths.size()) {
+            size_t end = paths.find(separator, start);
+            if (end == std::string::npos) {
+                end = paths.size();
+            }
+            if (end > start) {
+                assetOverridePaths.push_back(paths.substr(start, end - start));
+            }
+            start = end + 1;
+        }
+    }
+    for (auto& path : assetOverridePaths) {
+        if (!path.empty() && path.back() != '/' && path.back() != '\\') {
+            path += '/';
+        }
+    }
+
+    assetSearchPaths.clear();
+    if (char* basePath = SDL_GetBasePath()) {
+        assetSearchPaths.push_back(basePath); // Already ends with a separator
+        SDL_free(basePath);
+    }
+    assetSearchPaths.push_back(""); // Working directory
+}
+
+// Function to open an asset: configured paths first, then the copy embedded in the binary (no filesystem
+// access), then the executable and working directories. Returns nullptr if the asset is nowhere to be found.
+SDL_RWops* openAsset(const std::string& name) {
+    for (const auto& path : assetOverridePaths) {
+        if (SDL_RWops* file = SDL_RWFromFile((path + name).c_str(), "rb")) {
+            return file;
+        }
+    }
+    for (const auto& asset : embeddedAssets) {
+        if (asset.name && name == asset.name) {
+            return SDL_RWFromConstMem(asset.data, static_cast<int>(asset.size));
+        }
+    }
+    for (const auto& path : assetSearchPaths) {
+        if (SDL_RWops* file = SDL_RWFromFile((path + name).c_str(), "rb")) {
+            return file;
+        }
+    }
+    return nullptr;
+}
+
+// Function to load a BMP asset, substituting a solid placeholder so a missing file never stops the game
+SDL_Surface* loadAssetSurface(const std::string& name) {
+    SDL_RWops* file = openAsset(name);
+    SDL_Surface* loadedSurface = file ? SDL_LoadBMP_RW(file, 1) : nullptr;
+    if (loadedSurface) {
+        return loadedSurface;
+    }
+    std::cerr << "Unable to load image " << name << ", using a placeholder! SDL Error: " << SDL_GetError() << std::endl;
+
+    Color color = {200, 230, 200, 255}; // Pale green for backgrounds
+    if (name == "apple.bmp") color = {220, 30, 30, 255};
+    else if (name == "banana.bmp") color = {250, 220, 50, 255};
+    else if (name == "stone.bmp") color = {120, 120, 120, 255};
+    SDL_Surface* placeholder = SDL_CreateRGBSurfaceWithFormat(0, SNAKE_SIZE, SNAKE_SIZE, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (placeholder) {
+        SDL_FillRect(placeholder, nullptr, SDL_MapRGB(placeholder->format, color.r, color.g, color.b));
+    }
+    return placeholder;
+}
+
+// Function to open the font at the renderer's current pixel scale (call again when the window size or display changes)
+TTF_Font* openScaledFont(SDL_Renderer* renderer) {
+    float scale = fontScale;
+    int outputWidth, outputHeight;
+    if (SDL_GetRendererOutputSize(renderer, &outputWidth, &outputHeight) == 0) {
+        float scaleX = static_cast<float>(outputWidth) / SCREEN_WIDTH;
+        float scaleY = static_cast<float>(outputHeight) / SCREEN_HEIGHT;
+        scale = scaleX < scaleY ? scaleX : scaleY; // The logical size is letterboxed to the smaller scale
+    }
+    if (scale < 1.0f) {
+        scale = 1.0f;
+    }
+
+    // Only switch fontScale once a font opened, so a caller keeping its old font keeps the matching scale
+    int pointSize = static_cast<int>(FONT_SIZE * scale + 0.5f);
+    TTF_Font* font = nullptr;
+    if (SDL_RWops* file = openAsset(FONT_ASSET)) {
+        font = TTF_OpenFontRW(file, 1, pointSize);
+    }
+    for (const char* path : SYSTEM_FONT_PATHS) {
+        if (font) {
+            break;
+        }
+        font = TTF_OpenFont(path, pointSize);
+    }
+    if (font) {
+        fontScale = scale;
+    }
+    return font;
+}
+
+// Function to render text to a texture, reporting its size in logical pixels (nothing is drawn without a font)
+SDL_Texture* createTextTexture(SDL_Renderer* renderer, TTF_Font* font, const std::string& text, SDL_Color color,
+                               bool blended, int& width, int& height) {
+    SDL_Surface* textSurface = nullptr;
+    if (font) {
+        textSurface = blended ? TTF_RenderText_Blended(font, text.c_str(), color)
+                              : TTF_RenderText_Solid(font, text.c_str(), color);
+    }
+    if (!textSurface) {
+        width = height = 0;
+        return nullptr;
+    }
+    SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
+    width = static_cast<int>(textSurface->w / fontScale + 0.5f);
+    height = static_cast<int>(textSurface->h / fontScale + 0.5f);
+    SDL_FreeSurface(textSurface);
+    return textTexture;
+}
+
 // Function to initialize SDL
-bool init(SDL_Window*& window, SDL_Renderer*& renderer, TTF_Font*& font) {
+bool init(SDL_Window*& window, SDL_Renderer*& renderer, TTF_Font*& font, bool fullscreen, bool softwareRenderer) {
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
         return false;
@@ -74,8 +394,15 @@ bool init(SDL_Window*& window, SDL_Renderer*& renderer, TTF_Font*& font) {
         return false;
     }
 
+    // Scale textures smoothly when the logical size is stretched to the window
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+
+    Uint32 windowFlags = SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI;
+    if (fullscreen) {
+        windowFlags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
+    }
     window = SDL_CreateWindow("Snake Game by sumuuu", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-                              SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+                              SCREEN_WIDTH, SCREEN_HEIGHT, windowFlags);
     if (!window) {
         std::cerr << "Window could not be created! SDL_Error: " << SDL_GetError() << std::endl;
         SDL_Quit();
@@ -83,7 +410,7 @@ bool init(SDL_Window*& window, SDL_Renderer*& renderer, TTF_Font*& font) {
         return false;
     }
 
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    renderer = SDL_CreateRenderer(window, -1, softwareRenderer ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED);
     if (!renderer) {
         std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
         SDL_DestroyWindow(window);
@@ -92,23 +419,20 @@ bool init(SDL_Window*& window, SDL_Renderer*& renderer, TTF_Font*& font) {
         return false;
     }
 
-    font = TTF_OpenFont("/Library/Fonts/Arial Unicode.ttf", 24);
+    // Draw in SCREEN_WIDTH x SCREEN_HEIGHT coordinates at any window size or pixel density
+    SDL_RenderSetLogicalSize(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+    font = openScaledFont(renderer);
     if (!font) {
-        std::cerr << "Failed to load font! TTF_Error: " << TTF_GetError() << std::endl;
-        SDL_DestroyRenderer(renderer);
-        SDL_DestroyWindow(window);
-        SDL_Quit();
-        TTF_Quit();
-        return false;
+        std::cerr << "Failed to load font, text will not be shown! TTF_Error: " << TTF_GetError() << std::endl;
     }
 
     return true;
 }
 
 SDL_Texture* loadTexture(SDL_Renderer* renderer, const std::string& path) {
-    SDL_Surface* loadedSurface = SDL_LoadBMP(path.c_str());
+    SDL_Surface* loadedSurface = loadAssetSurface(path);
     if (!loadedSurface) {
-        std::cerr << "Unable to load image " << path << "! SDL Error: " << SDL_GetError() << std::endl;
         return nullptr;
     }
     SDL_Texture* newTexture = SDL_CreateTextureFromSurface(renderer, loadedSurface);
@@ -116,6 +440,43 @@ SDL_Texture* loadTexture(SDL_Renderer* renderer, const std::string& path) {
     return newTexture;
 }
 
+// Function to load a BMP as ARGB8888 pixels scaled to the given size, for the framebuffer path
+bool loadSprite(const std::string& path, int width, int height, std::vector<Uint32>& pixels) {
+    SDL_Surface* loadedSurface = loadAssetSurface(path);
+    if (!loadedSurface) {
+        return false;
+    }
+    SDL_Surface* scaledSurface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!scaledSurface || SDL_BlitScaled(loadedSurface, nullptr, scaledSurface, nullptr) < 0) {
+        std::cerr << "Unable to scale image " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+        SDL_FreeSurface(scaledSurface);
+        SDL_FreeSurface(loadedSurface);
+        return false;
+    }
+    pixels.resize(width * height);
+    for (int y = 0; y < height; ++y) {
+        const Uint32* row = reinterpret_cast<const Uint32*>(static_cast<const Uint8*>(scaledSurface->pixels) + y * scaledSurface->pitch);
+        std::copy(row, row + width, pixels.begin() + y * width);
+    }
+    SDL_FreeSurface(scaledSurface);
+    SDL_FreeSurface(loadedSurface);
+    return true;
+}
+
+// Function to set up the framebuffer rendering path: a streaming texture plus pre-scaled sprites
+bool initFramebuffer(SDL_Renderer* renderer) {
+    framebuffer.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+    if (!framebuffer.texture) {
+        std::cerr << "Framebuffer texture could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_SetTextureBlendMode(framebuffer.texture, SDL_BLENDMODE_NONE); // Every pixel is opaque, so skip the per-pixel alpha blend
+    return loadSprite("background.bmp", SCREEN_WIDTH, SCREEN_HEIGHT, framebuffer.background) &&
+           loadSprite("apple.bmp", SNAKE_SIZE, SNAKE_SIZE, framebuffer.appleSprite) &&
+           loadSprite("banana.bmp", SNAKE_SIZE, SNAKE_SIZE, framebuffer.bananaSprite) &&
+           loadSprite("stone.bmp", OBSTACLE_SIZE, OBSTACLE_SIZE, framebuffer.stoneSprite);
+}
+
 bool loadMedia(SDL_Renderer* renderer) {
     // Load BMP texture for background
     backgroundTexture = loadTexture(renderer, "background.bmp");
@@ -156,7 +517,9 @@ bool loadMedia(SDL_Renderer* renderer) {
 }
 
 void close(SDL_Window* window, SDL_Renderer* renderer, TTF_Font* font) {
-    TTF_CloseFont(font);
+    if (font) {
+        TTF_CloseFont(font);
+    }
     SDL_DestroyTexture(backgroundTexture);
     SDL_DestroyTexture(appleTexture);
     SDL_DestroyTexture(gameOverBackgroundTexture);
@@ -164,6 +527,9 @@ void close(SDL_Window* window, SDL_Renderer* renderer, TTF_Font* font) {
     SDL_DestroyTexture(startBackgroundTexture);
     SDL_DestroyTexture(stoneTexture);
     SDL_DestroyTexture(bananaTexture); // Destroy banana texture
+    if (framebuffer.texture) {
+        SDL_DestroyTexture(framebuffer.texture);
+    }
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     TTF_Quit();
@@ -223,11 +589,8 @@ void renderObstacles(SDL_Renderer* renderer, const std::vector<SDL_Rect>& obstac
 void renderScore(SDL_Renderer* renderer, TTF_Font* font, int score) {
     SDL_Color textColor = { 0, 0, 0, 255 }; // Black color
     std::string scoreText = "Score: " + std::to_string(score);
-    SDL_Surface* textSurface = TTF_RenderText_Solid(font, scoreText.c_str(), textColor);
-    SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-    int textWidth = textSurface->w;
-    int textHeight = textSurface->h;
-    SDL_FreeSurface(textSurface);
+    int textWidth, textHeight;
+    SDL_Texture* textTexture = createTextTexture(renderer, font, scoreText, textColor, false, textWidth, textHeight);
     SDL_Rect renderQuad = { 10, 10, textWidth, textHeight };
     SDL_RenderCopy(renderer, textTexture, nullptr, &renderQuad);
     SDL_DestroyTexture(textTexture);
@@ -238,12 +601,9 @@ void renderGameOver(SDL_Renderer* renderer, TTF_Font* font, int score) {
     SDL_Color textColor = { 0, 0, 0, 255 }; // Black color for text
     std::string gameOverText = "Game Over!! Final Score: " + std::to_string(score);
 
-    // Create text surface and texture
-    SDL_Surface* textSurface = TTF_RenderText_Solid(font, gameOverText.c_str(), textColor);
-    SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-    int textWidth = textSurface->w;
-    int textHeight = textSurface->h;
-    SDL_FreeSurface(textSurface);
+    // Create text texture
+    int textWidth, textHeight;
+    SDL_Texture* textTexture = createTextTexture(renderer, font, gameOverText, textColor, false, textWidth, textHeight);
 
     // Define the rectangle for the game over text box background
     int boxWidth = textWidth + 60;
@@ -268,12 +628,9 @@ void renderPause(SDL_Renderer* renderer, TTF_Font* font) {
     SDL_Color textColor = { 0, 0, 0, 255 }; // Black color for text
     std::string pauseText = "Game Paused. Press 'P' to resume.";
 
-    // Create text surface and texture
-    SDL_Surface* textSurface = TTF_RenderText_Solid(font, pauseText.c_str(), textColor);
-    SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-    int textWidth = textSurface->w;
-    int textHeight = textSurface->h;
-    SDL_FreeSurface(textSurface);
+    // Create text texture
+    int textWidth, textHeight;
+    SDL_Texture* textTexture = createTextTexture(renderer, font, pauseText, textColor, false, textWidth, textHeight);
 
     // Define the rectangle for the pause text box background
     int boxWidth = textWidth + 76;
@@ -298,12 +655,9 @@ void renderStartScreen(SDL_Renderer* renderer, TTF_Font* font) {
     SDL_Color textColor = { 0, 0, 0, 255 }; // Black color for text
     std::string startText = "Press 'Enter' to Start";
 
-    // Create text surface and texture
-    SDL_Surface* textSurface = TTF_RenderText_Solid(font, startText.c_str(), textColor);
-    SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-    int textWidth = textSurface->w;
-    int textHeight = textSurface->h;
-    SDL_FreeSurface(textSurface);
+    // Create text texture
+    int textWidth, textHeight;
+    SDL_Texture* textTexture = createTextTexture(renderer, font, startText, textColor, false, textWidth, textHeight);
 
     // Define the rectangle for the start text box background
     int boxWidth = textWidth + 60;
@@ -328,17 +682,13 @@ void renderLevelUp(SDL_Renderer* renderer, TTF_Font* font, const std::string& me
     std::string levelUpText1 = "Congo!! You are on " + message;
     std::string levelUpText2 = message == "level 2" ? "Be aware of the RUSSELL's VIPER SNAKE." : "Be aware of the stone.";
 
-    // Create text surface and texture for first line
-    SDL_Surface* textSurface1 = TTF_RenderText_Blended(font, levelUpText1.c_str(), textColor);
-    SDL_Texture* textTexture1 = SDL_CreateTextureFromSurface(renderer, textSurface1);
-    int textWidth1 = textSurface1->w;
-    int textHeight1 = textSurface1->h;
+    // Create text texture for first line
+    int textWidth1, textHeight1;
+    SDL_Texture* textTexture1 = createTextTexture(renderer, font, levelUpText1, textColor, true, textWidth1, textHeight1);
 
-    // Create text surface and texture for second line
-    SDL_Surface* textSurface2 = TTF_RenderText_Blended(font, levelUpText2.c_str(), textColor);
-    SDL_Texture* textTexture2 = SDL_CreateTextureFromSurface(renderer, textSurface2);
-    int textWidth2 = textSurface2->w;
-    int textHeight2 = textSurface2->h;
+    // Create text texture for second line
+    int textWidth2, textHeight2;
+    SDL_Texture* textTexture2 = createTextTexture(renderer, font, levelUpText2, textColor, true, textWidth2, textHeight2);
 
     // Define the rectangle for the level up text box background
     int boxWidth = customMax(textWidth1, textWidth2) + 80;
@@ -356,27 +706,18 @@ void renderLevelUp(SDL_Renderer* renderer, TTF_Font* font, const std::string& me
     SDL_RenderCopy(renderer, textTexture1, nullptr, &renderQuad1);
     SDL_RenderCopy(renderer, textTexture2, nullptr, &renderQuad2);
 
-    // Destroy the textures and surfaces
+    // Destroy the textures
     SDL_DestroyTexture(textTexture1);
-    SDL_FreeSurface(textSurface1);
     SDL_DestroyTexture(textTexture2);
-    SDL_FreeSurface(textSurface2);
 }
 
 // Function to render countdown timer
-void renderCountdownTimer(SDL_Renderer* renderer, TTF_Font* font, Uint32 countdownStartTime, Uint32 countdownDuration) {
-    Uint32 currentTime = SDL_GetTicks();
-    Uint32 elapsedTime = currentTime - countdownStartTime;
-    Uint32 remainingTime = countdownDuration - elapsedTime;
-
+void renderCountdownTimer(SDL_Renderer* renderer, TTF_Font* font, Uint32 remainingTime) {
     if (remainingTime > 0) {
         SDL_Color textColor = { 0, 0, 0, 255 }; // black color for timer
         std::string timerText = "Resuming in: " + std::to_string(remainingTime / 1000) + "s";
-        SDL_Surface* textSurface = TTF_RenderText_Solid(font, timerText.c_str(), textColor);
-        SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-        int textWidth = textSurface->w;
-        int textHeight = textSurface->h;
-        SDL_FreeSurface(textSurface);
+        int textWidth, textHeight;
+        SDL_Texture* textTexture = createTextTexture(renderer, font, timerText, textColor, false, textWidth, textHeight);
         SDL_Rect renderQuad = { (SCREEN_WIDTH - textWidth) / 2, (SCREEN_HEIGHT - textHeight) / 2, textWidth, textHeight };
         SDL_RenderCopy(renderer, textTexture, nullptr, &renderQuad);
         SDL_DestroyTexture(textTexture);
@@ -386,19 +727,12 @@ void renderCountdownTimer(SDL_Renderer* renderer, TTF_Font* font, Uint32 countdo
 
 
 // Function to render banana timer
-void renderBananaTimer(SDL_Renderer* renderer, TTF_Font* font, Uint32 bananaSpawnTime, Uint32 bananaLifetime) {
-    Uint32 currentTime = SDL_GetTicks();
-    Uint32 elapsedTime = currentTime - bananaSpawnTime;
-    Uint32 remainingTime = bananaLifetime - elapsedTime;
-
+void renderBananaTimer(SDL_Renderer* renderer, TTF_Font* font, Uint32 remainingTime) {
     if (remainingTime > 0) {
         SDL_Color textColor = { 0, 0, 0, 255 }; // black color for timer
         std::string timerText = "Banana disappears in: " + std::to_string(remainingTime / 1000) + "s";
-        SDL_Surface* textSurface = TTF_RenderText_Solid(font, timerText.c_str(), textColor);
-        SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-        int textWidth = textSurface->w;
-        int textHeight = textSurface->h;
-        SDL_FreeSurface(textSurface);
+        int textWidth, textHeight;
+        SDL_Texture* textTexture = createTextTexture(renderer, font, timerText, textColor, false, textWidth, textHeight);
         SDL_Rect renderQuad = { SCREEN_WIDTH - textWidth - 10, 10, textWidth, textHeight };
         SDL_RenderCopy(renderer, textTexture, nullptr, &renderQuad);
         SDL_DestroyTexture(textTexture);
@@ -435,63 +769,533 @@ void renderRandomSnake(SDL_Renderer* renderer, const RandomSnake& randomSnake) {
     }
 }
 
-// Function to update the snake's position
-void updateSnake(std::vector<SnakeSegment>& snake, Direction direction, bool& grow) {
-    SnakeSegment newHead = snake.front();
-    switch (direction) {
-        case UP: newHead.y -= SNAKE_SIZE; break;
-        case DOWN: newHead.y += SNAKE_SIZE; break;
-        case LEFT: newHead.x -= SNAKE_SIZE; break;
-        case RIGHT: newHead.x += SNAKE_SIZE; break;
+// Function to pack a color into an ARGB8888 pixel
+inline Uint32 packColor(const Color& color) {
+    return (static_cast<Uint32>(color.a) << 24) | (static_cast<Uint32>(color.r) << 16) |
+           (static_cast<Uint32>(color.g) << 8) | color.b;
+}
+
+// Function to fill a rectangle in the framebuffer; each row is one contiguous fill the compiler vectorizes
+void framebufferFillRect(int x, int y, int w, int h, Uint32 pixel) {
+    int x0 = customMax(x, 0), y0 = customMax(y, 0);
+    int x1 = std::min(x + w, SCREEN_WIDTH), y1 = std::min(y + h, SCREEN_HEIGHT);
+    if (x0 >= x1) {
+        return;
     }
-    snake.insert(snake.begin(), newHead);
-    if (!grow) {
-        snake.pop_back();
-    } else {
-        grow = false;
+    for (int row = y0; row < y1; ++row) {
+        std::fill_n(framebuffer.pixels + row * framebuffer.pitch + x0, x1 - x0, pixel);
+    }
+}
+
+// Function to draw a one-pixel rectangle outline in the framebuffer
+void framebufferDrawRect(int x, int y, int w, int h, Uint32 pixel) {
+    framebufferFillRect(x, y, w, 1, pixel);
+    framebufferFillRect(x, y + h - 1, w, 1, pixel);
+    framebufferFillRect(x, y, 1, h, pixel);
+    framebufferFillRect(x + w - 1, y, 1, h, pixel);
+}
+
+// Function to copy a pre-scaled sprite into the framebuffer, one row copy per sprite row
+void framebufferBlit(const std::vector<Uint32>& sprite, int x, int y, int w, int h) {
+    int x0 = customMax(x, 0), y0 = customMax(y, 0);
+    int x1 = std::min(x + w, SCREEN_WIDTH), y1 = std::min(y + h, SCREEN_HEIGHT);
+    if (x0 >= x1) {
+        return;
+    }
+    for (int row = y0; row < y1; ++row) {
+        auto source = sprite.begin() + (row - y) * w + (x0 - x);
+        std::copy(source, source + (x1 - x0), framebuffer.pixels + row * framebuffer.pitch + x0);
     }
 }
 
-// Function to update the random-moving snake's position
-void updateRandomSnake(RandomSnake& randomSnake, const std::vector<SDL_Rect>& obstacles, Uint32 currentTime) {
-    if (currentTime - randomSnake.lastMoveTime > randomSnake.moveInterval) {
-        // Randomly change direction with some probability
-        if (rand() % 4 == 0) { // Adjust this value to change the frequency of direction changes
-            randomSnake.direction = static_cast<Direction>(rand() % 4);
+// Function to draw a snake into the framebuffer, matching renderSnake and renderRandomSnake
+void framebufferRenderSnake(const std::vector<SnakeSegment>& segments, const Color& start, const Color& end) {
+    const Uint32 black = packColor({0, 0, 0, 255});
+    const Uint32 red = packColor({255, 0, 0, 255});
+    int numSegments = segments.size();
+    for (int i = 0; i < numSegments; ++i) {
+        float t = numSegments > 1 ? static_cast<float>(i) / (numSegments - 1) : 0.0f;
+        const SnakeSegment& segment = segments[i];
+        framebufferFillRect(segment.x, segment.y, SNAKE_SIZE, SNAKE_SIZE, packColor(calculateGradientColor(start, end, t)));
+        framebufferDrawRect(segment.x, segment.y, SNAKE_SIZE, SNAKE_SIZE, black);
+        if (i == 0) {
+            framebufferFillRect(segment.x + SNAKE_SIZE / 4, segment.y + SNAKE_SIZE / 4, SNAKE_SIZE / 5, SNAKE_SIZE / 5, red); // Eye
+            framebufferFillRect(segment.x + SNAKE_SIZE / 2, segment.y + SNAKE_SIZE, SNAKE_SIZE / 5, SNAKE_SIZE / 2, red);     // Tongue
         }
+    }
+}
+
+// Function to render the playfield straight into the locked streaming texture. The background overwrites
+// every pixel first, so the undefined contents of the locked buffer never show.
+void renderFramebufferPlayfield(SDL_Renderer* renderer, const std::vector<SnakeSegment>& snake, int foodX, int foodY,
+                                bool bananaActive, int bananaX, int bananaY, const std::vector<SDL_Rect>& obstacles,
+                                const std::vector<RandomSnake>& randomSnakes, bool randomSnakeActive) {
+    void* texturePixels;
+    int pitch;
+    if (SDL_LockTexture(framebuffer.texture, nullptr, &texturePixels, &pitch) != 0) {
+        return;
+    }
+    framebuffer.pixels = static_cast<Uint32*>(texturePixels);
+    framebuffer.pitch = pitch / static_cast<int>(sizeof(Uint32));
 
-        // Update the snake's position based on the current direction
-        SnakeSegment newHead = randomSnake.segments.front();
-        switch (randomSnake.direction) {
-            case UP: newHead.y -= SNAKE_SIZE; break;
-            case DOWN: newHead.y += SNAKE_SIZE; break;
-            case LEFT: newHead.x -= SNAKE_SIZE; break;
-            case RIGHT: newHead.x += SNAKE_SIZE; break;
+    for (int row = 0; row < SCREEN_HEIGHT; ++row) {
+        auto source = framebuffer.background.begin() + row * SCREEN_WIDTH;
+        std::copy(source, source + SCREEN_WIDTH, framebuffer.pixels + row * framebuffer.pitch);
+    }
+    framebufferRenderSnake(snake, startColor, endColor);
+    framebufferBlit(framebuffer.appleSprite, foodX, foodY, SNAKE_SIZE, SNAKE_SIZE);
+    if (bananaActive) {
+        framebufferBlit(framebuffer.bananaSprite, bananaX, bananaY, SNAKE_SIZE, SNAKE_SIZE);
+    }
+    for (const auto& obstacle : obstacles) {
+        framebufferBlit(framebuffer.stoneSprite, obstacle.x, obstacle.y, OBSTACLE_SIZE, OBSTACLE_SIZE);
+    }
+    if (randomSnakeActive) {
+        for (const auto& randomSnake : randomSnakes) {
+            framebufferRenderSnake(randomSnake.segments, {255, 165, 0, 255}, {255, 140, 0, 255});
         }
+    }
 
-        // Check for collisions with obstacles and screen boundaries
-        if (newHead.x < 0) newHead.x = SCREEN_WIDTH - SNAKE_SIZE;
-        else if (newHead.x >= SCREEN_WIDTH) newHead.x = 0;
-        if (newHead.y < 0) newHead.y = SCREEN_HEIGHT - SNAKE_SIZE;
-        else if (newHead.y >= SCREEN_HEIGHT) newHead.y = 0;
+    SDL_UnlockTexture(framebuffer.texture);
+    framebuffer.pixels = nullptr;
+    SDL_RenderCopy(renderer, framebuffer.texture, nullptr, nullptr);
+}
 
-        bool collision = false;
-        for (const auto& obstacle : obstacles) {
-            if (newHead.x < obstacle.x + obstacle.w && newHead.x + SNAKE_SIZE > obstacle.x &&
-                newHead.y < obstacle.y + obstacle.h && newHead.y + SNAKE_SIZE > obstacle.y) {
-                collision = true;
+// Function to write queued frames to the Y4M file until capture stops; runs on the encoder thread
+void runCaptureEncoder(VideoCapture* capture) {
+    const size_t planeSize = static_cast<size_t>(capture->width) * capture->height;
+    std::vector<Uint8> planes(planeSize * 3); // Y, U and V planes
+    while (true) {
+        QueuedFrame frame;
+        {
+            std::unique_lock<std::mutex> lock(capture->mutex);
+            capture->frameReady.wait(lock, [capture] { return capture->stopping || !capture->queuedFrames.empty(); });
+            if (capture->queuedFrames.empty()) {
+                return; // Stopping and every queued frame is written
+            }
+            frame = capture->queuedFrames.front();
+            capture->queuedFrames.pop_front();
+        }
+
+        // Convert to full range BT.601 YUV 4:4:4 without holding the lock
+        const Uint8* rgb = capture->buffers[frame.buffer].data();
+        for (size_t i = 0; i < planeSize; ++i) {
+            int r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+            planes[i] = static_cast<Uint8>((77 * r + 150 * g + 29 * b) >> 8);
+            planes[planeSize + i] = static_cast<Uint8>(((-43 * r - 85 * g + 128 * b) >> 8) + 128);
+            planes[planeSize * 2 + i] = static_cast<Uint8>(((128 * r - 107 * g - 21 * b) >> 8) + 128);
+        }
+        {
+            std::lock_guard<std::mutex> lock(capture->mutex);
+            capture->freeBuffers.push_back(frame.buffer);
+        }
+        for (int i = 0; i < frame.repeats; ++i) {
+            capture->file << "FRAME\n";
+            capture->file.write(reinterpret_cast<const char*>(planes.data()), planes.size());
+        }
+    }
+}
+
+// Function to start recording presented frames at the renderer's current output size
+bool startCapture(VideoCapture& capture, SDL_Renderer* renderer, const std::string& path) {
+    if (SDL_GetRendererOutputSize(renderer, &capture.width, &capture.height) != 0) {
+        std::cerr << "Unable to start capture! SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    capture.file.open(path, std::ios::binary);
+    if (!capture.file) {
+        std::cerr << "Unable to open capture file " << path << "!" << std::endl;
+        return false;
+    }
+    capture.file << "YUV4MPEG2 W" << capture.width << " H" << capture.height << " F" << CAPTURE_FPS
+                 << ":1 Ip A1:1 C444 XCOLORRANGE=FULL\n";
+
+    capture.buffers.assign(CAPTURE_BUFFER_COUNT, std::vector<Uint8>(static_cast<size_t>(capture.width) * capture.height * 3));
+    capture.freeBuffers.clear();
+    for (int i = 0; i < CAPTURE_BUFFER_COUNT; ++i) {
+        capture.freeBuffers.push_back(i);
+    }
+    capture.stopping = false;
+    capture.startTicks = SDL_GetTicks();
+    capture.streamFrames = 0;
+    capture.encoder = std::thread(runCaptureEncoder, &capture);
+    capture.active = true;
+    return true;
+}
+
+// Function to read back the frame about to be presented and queue it for the encoder, returning the
+// performance counter ticks spent. A frame is dropped rather than waited for when every buffer is still
+// queued, or when the window no longer has the size the stream was started with; the next captured
+// frame then fills the gap so the stream keeps its wall-clock timing.
+Uint64 captureFrame(VideoCapture& capture, SDL_Renderer* renderer, FrameStats& stats) {
+    Uint64 dueFrames = static_cast<Uint64>(SDL_GetTicks() - capture.startTicks) * CAPTURE_FPS / 1000 + 1;
+    if (dueFrames <= capture.streamFrames) {
+        return 0; // The next stream frame is not due yet
+    }
+
+    Uint64 captureStart = SDL_GetPerformanceCounter();
+    int bufferIndex = -1;
+    int outputWidth, outputHeight;
+    if (SDL_GetRendererOutputSize(renderer, &outputWidth, &outputHeight) == 0 &&
+        outputWidth == capture.width && outputHeight == capture.height) {
+        std::lock_guard<std::mutex> lock(capture.mutex);
+        if (!capture.freeBuffers.empty()) {
+            bufferIndex = capture.freeBuffers.back();
+            capture.freeBuffers.pop_back();
+        }
+    }
+    if (bufferIndex < 0) {
+        stats.droppedFrames++;
+    } else {
+        // Read in output pixels: SDL places the letterboxed viewport at its offset and the bars stay black
+        SDL_Rect outputRect = { 0, 0, capture.width, capture.height };
+        SDL_RenderReadPixels(renderer, &outputRect, SDL_PIXELFORMAT_RGB24, capture.buffers[bufferIndex].data(), capture.width * 3);
+        {
+            std::lock_guard<std::mutex> lock(capture.mutex);
+            capture.queuedFrames.push_back({ bufferIndex, static_cast<int>(dueFrames - capture.streamFrames) });
+        }
+        capture.frameReady.notify_one();
+        capture.streamFrames = dueFrames;
+        stats.capturedFrames++;
+    }
+    Uint64 captureTicks = SDL_GetPerformanceCounter() - captureStart;
+    stats.captureTicks += captureTicks;
+    return captureTicks;
+}
+
+// Function to finish writing the queued frames and close the capture file
+void stopCapture(VideoCapture& capture) {
+    if (!capture.active) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(capture.mutex);
+        capture.stopping = true;
+    }
+    capture.frameReady.notify_one();
+    capture.encoder.join();
+    capture.file.close();
+    capture.active = false;
+}
+
+// Function to present the rendered frame, capturing it first if recording; returns the ticks spent capturing
+Uint64 presentFrame(SDL_Renderer* renderer, VideoCapture& capture, FrameStats& stats) {
+    Uint64 captureTicks = 0;
+    if (capture.active) {
+        captureTicks = captureFrame(capture, renderer, stats);
+    }
+    SDL_RenderPresent(renderer);
+    return captureTicks;
+}
+
+// Function to mix the playing voices into the device buffer; runs on SDL's audio thread
+void mixAudio(void* userdata, Uint8* stream, int length) {
+    AudioEngine* audio = static_cast<AudioEngine*>(userdata);
+
+    // Start the sounds requested since the last callback
+    Uint32 read = audio->queueRead.load(std::memory_order_relaxed);
+    Uint32 write = audio->queueWrite.load(std::memory_order_acquire);
+    for (; read != write; ++read) {
+        const AudioCommand& command = audio->queue[read & (AUDIO_QUEUE_SIZE - 1)];
+        const std::vector<float>& sound = audio->sounds[command.sound];
+        if (sound.empty()) {
+            continue;
+        }
+        // Use a free voice, or steal the one closest to finishing
+        AudioVoice* target = &audio->voices[0];
+        for (auto& voice : audio->voices) {
+            if (!voice.samples) {
+                target = &voice;
                 break;
             }
+            if (voice.length - voice.position < target->length - target->position) {
+                target = &voice;
+            }
+        }
+        target->samples = sound.data();
+        target->length = sound.size();
+        target->position = 0;
+        target->volume = command.volume;
+    }
+    audio->queueRead.store(read, std::memory_order_release);
+
+    float* output = reinterpret_cast<float*>(stream);
+    int sampleCount = length / static_cast<int>(sizeof(float));
+    std::fill_n(output, sampleCount, 0.0f);
+    for (auto& voice : audio->voices) {
+        if (!voice.samples) {
+            continue;
         }
+        size_t count = std::min(static_cast<size_t>(sampleCount), voice.length - voice.position);
+        const float* source = voice.samples + voice.position;
+        for (size_t i = 0; i < count; ++i) {
+            output[i] += source[i] * voice.volume;
+        }
+        voice.position += count;
+        if (voice.position >= voice.length) {
+            voice.samples = nullptr;
+        }
+    }
+    for (int i = 0; i < sampleCount; ++i) {
+        output[i] = std::max(-1.0f, std::min(1.0f, output[i]));
+    }
+}
+
+// Function to synthesize a sound effect, used when its WAV file is not available
+std::vector<float> synthesizeSound(SoundEffect sound) {
+    const float pi = 3.14159265f;
+    float seconds = 0.1f;
+    switch (sound) {
+        case SOUND_EAT_APPLE: seconds = 0.08f; break;
+        case SOUND_EAT_BANANA: seconds = 0.2f; break;
+        case SOUND_LEVEL_UP: seconds = 0.5f; break;
+        case SOUND_COLLISION: seconds = 0.35f; break;
+        case SOUND_COUNTDOWN: seconds = 0.12f; break;
+        default: break;
+    }
+    std::vector<float> samples(static_cast<size_t>(seconds * AUDIO_FREQUENCY));
+    Uint32 noise = 0x12345678u;
+    float phase = 0.0f;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        float t = static_cast<float>(i) / samples.size(); // 0 to 1 over the sound
+        float frequency = 880.0f;
+        switch (sound) {
+            case SOUND_EAT_APPLE: frequency = 880.0f; break;
+            case SOUND_EAT_BANANA: frequency = t < 0.5f ? 660.0f : 990.0f; break; // Two-note chirp
+            case SOUND_LEVEL_UP: frequency = 440.0f + 440.0f * t; break;          // Rising sweep
+            case SOUND_COUNTDOWN: frequency = 660.0f; break;
+            default: break;
+        }
+        phase += 2.0f * pi * frequency / AUDIO_FREQUENCY;
+        float value;
+        if (sound == SOUND_COLLISION) {
+            noise = noise * 1664525u + 1013904223u; // Crash of decaying noise
+            value = (static_cast<float>(noise >> 8) / (1 << 24)) * 2.0f - 1.0f;
+        } else {
+            value = std::sin(phase);
+        }
+        samples[i] = 0.3f * value * (1.0f - t); // Fade out to avoid a click
+    }
+    return samples;
+}
+
+// Function to load a WAV asset converted to the mixer format, or synthesize the sound if it is missing
+std::vector<float> loadSound(SoundEffect sound, const std::string& name) {
+    SDL_AudioSpec wavSpec;
+    Uint8* wavBuffer = nullptr;
+    Uint32 wavLength = 0;
+    SDL_RWops* file = openAsset(name);
+    if (!file || !SDL_LoadWAV_RW(file, 1, &wavSpec, &wavBuffer, &wavLength)) {
+        return synthesizeSound(sound);
+    }
+
+    std::vector<float> samples;
+    SDL_AudioCVT converter;
+    if (SDL_BuildAudioCVT(&converter, wavSpec.format, wavSpec.channels, wavSpec.freq, AUDIO_F32SYS, 1, AUDIO_FREQUENCY) >= 0) {
+        converter.len = static_cast<int>(wavLength);
+        converter.buf = static_cast<Uint8*>(SDL_malloc(static_cast<size_t>(wavLength) * converter.len_mult));
+        if (converter.buf) {
+            std::memcpy(converter.buf, wavBuffer, wavLength);
+            if (SDL_ConvertAudio(&converter) == 0) {
+                const float* converted = reinterpret_cast<const float*>(converter.buf);
+                samples.assign(converted, converted + converter.len_cvt / sizeof(float));
+            }
+            SDL_free(converter.buf);
+        }
+    }
+    SDL_FreeWAV(wavBuffer);
+    return samples.empty() ? synthesizeSound(sound) : samples;
+}
+
+// Function to open the audio device and prepare every sound; the game runs silently if this fails
+void startAudio(AudioEngine& audio) {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+        std::cerr << "SDL audio could not initialize, playing without sound! SDL_Error: " << SDL_GetError() << std::endl;
+        return;
+    }
+    const char* const soundFiles[SOUND_COUNT] = { "apple.wav", "banana.wav", "levelup.wav", "collision.wav", "countdown.wav" };
+    for (int i = 0; i < SOUND_COUNT; ++i) {
+        audio.sounds[i] = loadSound(static_cast<SoundEffect>(i), soundFiles[i]);
+    }
+
+    SDL_AudioSpec desired = {};
+    desired.freq = AUDIO_FREQUENCY;
+    desired.format = AUDIO_F32SYS;
+    desired.channels = 1;
+    desired.samples = AUDIO_BUFFER_SAMPLES;
+    desired.callback = mixAudio;
+    desired.userdata = &audio;
+    audio.device = SDL_OpenAudioDevice(nullptr, 0, &desired, nullptr, 0); // SDL converts to the hardware format
+    if (audio.device == 0) {
+        std::cerr << "Audio device could not be opened, playing without sound! SDL_Error: " << SDL_GetError() << std::endl;
+        return;
+    }
+    SDL_PauseAudioDevice(audio.device, 0);
+}
+
+// Function to request a sound from the game thread; never blocks, and drops the request if the queue is full
+void playSound(AudioEngine& audio, SoundEffect sound, float volume = 1.0f) {
+    if (audio.device == 0) {
+        return;
+    }
+    Uint32 write = audio.queueWrite.load(std::memory_order_relaxed);
+    if (write - audio.queueRead.load(std::memory_order_acquire) >= static_cast<Uint32>(AUDIO_QUEUE_SIZE)) {
+        return;
+    }
+    audio.queue[write & (AUDIO_QUEUE_SIZE - 1)] = { sound, volume };
+    audio.queueWrite.store(write + 1, std::memory_order_release);
+}
+
+// Function to close the audio device
+void stopAudio(AudioEngine& audio) {
+    if (audio.device != 0) {
+        SDL_CloseAudioDevice(audio.device);
+        audio.device = 0;
+    }
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+}
+
+// Function to record one rendered frame, minus the time spent capturing it, and print the average
+// render time every few hundred frames
+void recordFrameStats(FrameStats& stats, Uint64 renderStart, Uint64 captureTicks, bool useFramebuffer) {
+    stats.renderTicks += SDL_GetPerformanceCounter() - renderStart - captureTicks;
+    if (++stats.frames == 300) {
+        double averageMs = 1000.0 * stats.renderTicks / SDL_GetPerformanceFrequency() / stats.frames;
+        std::cout << "Render (" << (useFramebuffer ? "framebuffer" : "renderer") << "): " << averageMs << " ms/frame"; // --benchmark report
+        if (stats.capturedFrames > 0 || stats.droppedFrames > 0) {
+            double captureMs = stats.capturedFrames > 0 ? 1000.0 * stats.captureTicks / SDL_GetPerformanceFrequency() / stats.capturedFrames : 0.0;
+            std::cout << ", capture: " << captureMs << " ms/frame, " << stats.droppedFrames << " dropped";
+        }
+        std::cout << "\n";
+        stats = FrameStats();
+    }
+}
+
+// Function to scramble a 64-bit value (splitmix64 finalizer)
+inline Uint64 mixHash(Uint64 value) {
+    value += 0x9e3779b97f4a7c15ull;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
 
-        if (!collision) {
-            randomSnake.segments.insert(randomSnake.segments.begin(), newHead);
-            randomSnake.segments.pop_back();
-            randomSnake.lastMoveTime = currentTime;
+// Function to fill the Zobrist key tables
+void initHashKeys() {
+    Uint64 state = 0x5a0b2c3d4e5f6071ull;
+    for (auto& pieceKeys : cellHashKeys) {
+        for (auto& key : pieceKeys) {
+            key = mixHash(state++);
         }
     }
+    for (auto& key : directionHashKeys) {
+        key = mixHash(state++);
+    }
+}
+
+// Function to toggle a cell's content in the state hash; adding and removing are the same XOR.
+// Cells off the board (a snake head that just crashed) are not hashed.
+inline void hashCell(Uint64& stateHash, HashPiece piece, int x, int y) {
+    if (x >= 0 && x < SCREEN_WIDTH && y >= 0 && y < SCREEN_HEIGHT) {
+        stateHash ^= cellHashKeys[piece][cellIndex(x, y)];
+    }
+}
+
+// Function to toggle every cell covered by an obstacle in the state hash
+void hashObstacle(Uint64& stateHash, const SDL_Rect& obstacle) {
+    for (int y = obstacle.y; y < obstacle.y + obstacle.h; y += SNAKE_SIZE) {
+        for (int x = obstacle.x; x < obstacle.x + obstacle.w; x += SNAKE_SIZE) {
+            hashCell(stateHash, OBSTACLE_CELL, x, y);
+        }
+    }
+}
+
+// Function to toggle the score in the state hash (hash it out with the old value, in with the new one)
+inline void hashScore(Uint64& stateHash, int score) {
+    stateHash ^= mixHash(0x73636f7265000000ull ^ static_cast<Uint32>(score));
+}
+
+// Function to toggle the level in the state hash
+void hashLevel(Uint64& stateHash, const std::string& level) {
+    Uint64 value = 0xcbf29ce484222325ull; // FNV-1a of the level name
+    for (char c : level) {
+        value = (value ^ static_cast<Uint8>(c)) * 0x100000001b3ull;
+    }
+    stateHash ^= mixHash(value);
 }
 
+// Function to hash the whole game state from scratch; the game keeps the same value up to date
+// incrementally, and this is used to start it and to check that it has not drifted
+Uint64 computeStateHash(const std::vector<SnakeSegment>& snake, const std::vector<RandomSnake>& randomSnakes,
+                        const std::vector<SDL_Rect>& obstacles, int foodX, int foodY, bool bananaActive,
+                        int bananaX, int bananaY, int score, const std::string& level, Direction direction) {
+    Uint64 stateHash = directionHashKeys[direction];
+    for (const auto& segment : snake) {
+        hashCell(stateHash, PLAYER_CELL, segment.x, segment.y);
+    }
+    for (const auto& randomSnake : randomSnakes) {
+        for (const auto& segment : randomSnake.segments) {
+            hashCell(stateHash, RANDOM_SNAKE_CELL, segment.x, segment.y);
+        }
+    }
+    for (const auto& obstacle : obstacles) {
+        hashObstacle(stateHash, obstacle);
+    }
+    hashCell(stateHash, FOOD_CELL, foodX, foodY);
+    if (bananaActive) {
+        hashCell(stateHash, BANANA_CELL, bananaX, bananaY);
+    }
+    hashScore(stateHash, score);
+    hashLevel(stateHash, level);
+    return stateHash;
+}
+
+// Function to write or verify a state hash checkpoint. Each line of a checkpoint file is "tick hash";
+// the first mismatch against the expected file is reported as a desync.
+void checkpointStateHash(Uint32 tick, Uint64 stateHash, Uint64 recomputedHash, std::ofstream& hashLog,
+                         std::ifstream& expectedHashes, bool& desyncReported) {
+    if (stateHash != recomputedHash) {
+        std::cerr << "State hash drifted at tick " << tick << "! Incremental " << std::hex << stateHash
+                  << ", recomputed " << recomputedHash << std::dec << std::endl;
+    }
+    if (hashLog.is_open()) {
+        hashLog << tick << " " << std::hex << stateHash << std::dec << "\n";
+    }
+    Uint32 expectedTick;
+    Uint64 expectedHash;
+    if (expectedHashes.is_open() && !desyncReported && expectedHashes >> expectedTick >> std::hex >> expectedHash >> std::dec) {
+        if (expectedTick != tick || expectedHash != stateHash) {
+            std::cerr << "Desync at tick " << tick << "! Expected " << std::hex << expectedHash << ", got "
+                      << stateHash << std::dec << std::endl;
+            desyncReported = true;
+        }
+    }
+}
+
+// Function to add points to the score, keeping the state hash in step
+void addScore(int& score, int points, Uint64& stateHash) {
+    hashScore(stateHash, score);
+    score += points;
+    hashScore(stateHash, score);
+}
+
+// Function to update the snake's position
+void updateSnake(std::vector<SnakeSegment>& snake, Direction direction, bool& grow, Uint64& stateHash) {
+    SnakeSegment newHead = snake.front();
+    switch (direction) {
+        case UP: newHead.y -= SNAKE_SIZE; break;
+        case DOWN: newHead.y += SNAKE_SIZE; break;
+        case LEFT: newHead.x -= SNAKE_SIZE; break;
+        case RIGHT: newHead.x += SNAKE_SIZE; break;
+    }
+    snake.insert(snake.begin(), newHead);
+    hashCell(stateHash, PLAYER_CELL, newHead.x, newHead.y);
+    if (!grow) {
+        hashCell(stateHash, PLAYER_CELL, snake.back().x, snake.back().y);
+        snake.pop_back();
+    } else {
+        grow = false;
+    }
+}
 
 // Function to check collision with the food
 bool checkFoodCollision(int foodX, int foodY, const SnakeSegment& head) {
@@ -534,97 +1338,549 @@ bool checkCollision(const std::vector<SnakeSegment>& snake, const std::vector<SD
     return false;
 }
 
-// Function to generate food in a random position
-void generateFood(int& foodX, int& foodY, const std::vector<SnakeSegment>& snake, const std::vector<SDL_Rect>& obstacles, const RandomSnake& randomSnake) {
+// Function to check if a grid cell lies anywhere inside an obstacle (not just its corner)
+bool isObstacleCell(int x, int y, const std::vector<SDL_Rect>& obstacles) {
+    for (const auto& obstacle : obstacles) {
+        if (x < obstacle.x + obstacle.w && x + SNAKE_SIZE > obstacle.x &&
+            y < obstacle.y + obstacle.h && y + SNAKE_SIZE > obstacle.y) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function to mark every grid cell covered by an obstacle
+CellGrid buildObstacleGrid(const std::vector<SDL_Rect>& obstacles) {
+    CellGrid grid;
+    for (const auto& obstacle : obstacles) {
+        for (int y = obstacle.y; y < obstacle.y + obstacle.h; y += SNAKE_SIZE) {
+            for (int x = obstacle.x; x < obstacle.x + obstacle.w; x += SNAKE_SIZE) {
+                grid.set(cellIndex(x, y));
+            }
+        }
+    }
+    return grid;
+}
+
+// Function to grow a set of cells by one step in all four directions (no wrap-around)
+CellGrid dilateCells(const CellGrid& cells) {
+    static CellGrid notFirstCol, notLastCol;
+    static bool masksReady = false;
+    if (!masksReady) {
+        notFirstCol.set();
+        notLastCol.set();
+        for (int row = 0; row < GRID_ROWS; ++row) {
+            notFirstCol.reset(row * GRID_COLS);
+            notLastCol.reset(row * GRID_COLS + GRID_COLS - 1);
+        }
+        masksReady = true;
+    }
+    // Shifting by one moves cells sideways; the masks drop cells that wrapped onto the next row
+    return cells | ((cells << 1) & notFirstCol) | ((cells >> 1) & notLastCol) |
+           (cells << GRID_COLS) | (cells >> GRID_COLS);
+}
+
+// Function to flood fill the free cells reachable from a start cell, a whole row of bits at a time
+CellGrid floodFill(const CellGrid& freeCells, int startIndex) {
+    CellGrid reached;
+    if (!freeCells.test(startIndex)) {
+        return reached;
+    }
+    reached.set(startIndex);
+    while (true) {
+        CellGrid next = dilateCells(reached) & freeCells;
+        if (next == reached) {
+            return reached;
+        }
+        reached = next;
+    }
+}
+
+// Function to generate a seeded obstacle layout in which every free cell stays connected.
+// Only std::mt19937 output is used (not std::shuffle or distributions), so a seed yields the
+// same layout on every platform; layouts are cached by seed and density.
+// Slots are tried once each: a stone that would split the board can never become acceptable
+// once more stones are placed, so retrying would not help. Densities above about 55% are
+// therefore capped by the connectivity rule (100% yields roughly 104-131 of the 192 slots).
+const std::vector<SDL_Rect>& generateLevelLayout(unsigned int seed, int densityPercent) {
+    static std::map<std::pair<unsigned int, int>, std::vector<SDL_Rect>> layoutCache;
+    std::pair<unsigned int, int> key(seed, densityPercent);
+    auto cached = layoutCache.find(key);
+    if (cached != layoutCache.end()) {
+        return cached->second;
+    }
+
+    const int slotCols = SCREEN_WIDTH / OBSTACLE_SIZE;
+    const int slotRows = SCREEN_HEIGHT / OBSTACLE_SIZE;
+    std::vector<int> slots(slotCols * slotRows);
+    for (size_t i = 0; i < slots.size(); ++i) {
+        slots[i] = static_cast<int>(i);
+    }
+    std::mt19937 rng(seed);
+    for (size_t i = slots.size() - 1; i > 0; --i) {
+        std::swap(slots[i], slots[rng() % (i + 1)]);
+    }
+
+    int targetCount = static_cast<int>(slots.size()) * densityPercent / 100;
+    std::vector<SDL_Rect>& layout = layoutCache[key];
+    CellGrid blocked;
+    for (size_t i = 0; i < slots.size() && static_cast<int>(layout.size()) < targetCount; ++i) {
+        SDL_Rect stone = { (slots[i] % slotCols) * OBSTACLE_SIZE, (slots[i] / slotCols) * OBSTACLE_SIZE,
+                           OBSTACLE_SIZE, OBSTACLE_SIZE };
+        CellGrid candidate = blocked | buildObstacleGrid({ stone });
+        CellGrid freeCells = ~candidate;
+
+        // Reject the stone if it would split the board into separate regions or leave no free cell
+        size_t startIndex = 0;
+        while (startIndex < candidate.size() && candidate.test(startIndex)) {
+            ++startIndex;
+        }
+        if (startIndex < candidate.size() && floodFill(freeCells, static_cast<int>(startIndex)) == freeCells) {
+            blocked = candidate;
+            layout.push_back(stone);
+        }
+    }
+    return layout;
+}
+
+// Function to generate food in a random position (foodX of -1 means there is no food yet)
+void generateFood(int& foodX, int& foodY, const std::vector<SnakeSegment>& snake, const std::vector<SDL_Rect>& obstacles, const std::vector<RandomSnake>& randomSnakes, std::mt19937& rng, Uint64& stateHash) {
+    hashCell(stateHash, FOOD_CELL, foodX, foodY);
     bool validPosition = false;
     while (!validPosition) {
         validPosition = true;
-        foodX = (rand() % (SCREEN_WIDTH / SNAKE_SIZE)) * SNAKE_SIZE;
-        foodY = (rand() % (SCREEN_HEIGHT / SNAKE_SIZE)) * SNAKE_SIZE;
+        foodX = static_cast<int>(rng() % (SCREEN_WIDTH / SNAKE_SIZE)) * SNAKE_SIZE;
+        foodY = static_cast<int>(rng() % (SCREEN_HEIGHT / SNAKE_SIZE)) * SNAKE_SIZE;
         for (const auto& segment : snake) {
             if (segment.x == foodX && segment.y == foodY) {
                 validPosition = false;
                 break;
             }
         }
-        for (const auto& obstacle : obstacles) {
-            if (obstacle.x == foodX && obstacle.y == foodY) {
-                validPosition = false;
-                break;
-            }
+        if (isObstacleCell(foodX, foodY, obstacles)) {
+            validPosition = false;
         }
-        for (const auto& segment : randomSnake.segments) {
-            if (segment.x == foodX && segment.y == foodY) {
-                validPosition = false;
-                break;
+        for (const auto& randomSnake : randomSnakes) {
+            for (const auto& segment : randomSnake.segments) {
+                if (segment.x == foodX && segment.y == foodY) {
+                    validPosition = false;
+                    break;
+                }
             }
         }
     }
+    hashCell(stateHash, FOOD_CELL, foodX, foodY);
 }
 
 // Function to generate banana in a random position
-void generateBanana(int& bananaX, int& bananaY, const std::vector<SnakeSegment>& snake, const std::vector<SDL_Rect>& obstacles, const RandomSnake& randomSnake) {
+void generateBanana(int& bananaX, int& bananaY, const std::vector<SnakeSegment>& snake, const std::vector<SDL_Rect>& obstacles, const std::vector<RandomSnake>& randomSnakes, std::mt19937& rng, Uint64& stateHash) {
     bool validPosition = false;
     while (!validPosition) {
         validPosition = true;
-        bananaX = (rand() % (SCREEN_WIDTH / SNAKE_SIZE)) * SNAKE_SIZE;
-        bananaY = (rand() % (SCREEN_HEIGHT / SNAKE_SIZE)) * SNAKE_SIZE;
+        bananaX = static_cast<int>(rng() % (SCREEN_WIDTH / SNAKE_SIZE)) * SNAKE_SIZE;
+        bananaY = static_cast<int>(rng() % (SCREEN_HEIGHT / SNAKE_SIZE)) * SNAKE_SIZE;
         for (const auto& segment : snake) {
             if (segment.x == bananaX && segment.y == bananaY) {
                 validPosition = false;
                 break;
             }
         }
-        for (const auto& obstacle : obstacles) {
-            if (obstacle.x == bananaX && obstacle.y == bananaY) {
-                validPosition = false;
-                break;
+        if (isObstacleCell(bananaX, bananaY, obstacles)) {
+            validPosition = false;
+        }
+        for (const auto& randomSnake : randomSnakes) {
+            for (const auto& segment : randomSnake.segments) {
+                if (segment.x == bananaX && segment.y == bananaY) {
+                    validPosition = false;
+                    break;
+                }
             }
         }
+    }
+    hashCell(stateHash, BANANA_CELL, bananaX, bananaY);
+}
+
+// Function to reserve the few cells in front of the player's head so nothing is placed in its path
+void reserveCellsAhead(CellGrid& reserved, SnakeSegment ahead, Direction direction) {
+    for (int i = 0; i < 3; ++i) {
+        switch (direction) {
+            case UP: ahead.y -= SNAKE_SIZE; break;
+            case DOWN: ahead.y += SNAKE_SIZE; break;
+            case LEFT: ahead.x -= SNAKE_SIZE; break;
+            case RIGHT: ahead.x += SNAKE_SIZE; break;
+        }
+        if (ahead.x < 0 || ahead.x >= SCREEN_WIDTH || ahead.y < 0 || ahead.y >= SCREEN_HEIGHT) {
+            break;
+        }
+        reserved.set(cellIndex(ahead.x, ahead.y));
+    }
+}
+
+// Function to generate obstacles from the seeded layout, keeping the snake's path, the random snakes,
+// the food, an active banana and every free cell reachable from the snake's head
+void generateObstacles(std::vector<SDL_Rect>& obstacles, const std::vector<SnakeSegment>& snake, Direction direction,
+                       const std::vector<RandomSnake>& randomSnakes, int foodX, int foodY, bool bananaActive,
+                       int bananaX, int bananaY, unsigned int seed, int densityPercent, Uint64& stateHash) {
+    for (const auto& obstacle : obstacles) {
+        hashObstacle(stateHash, obstacle);
+    }
+    obstacles = generateLevelLayout(seed, densityPercent);
+
+    // Reserve the cells in use plus a few cells ahead of the head so the snake is never boxed in on arrival
+    CellGrid reserved;
+    for (const auto& segment : snake) {
+        reserved.set(cellIndex(segment.x, segment.y));
+    }
+    for (const auto& randomSnake : randomSnakes) {
         for (const auto& segment : randomSnake.segments) {
-            if (segment.x == bananaX && segment.y == bananaY) {
+            reserved.set(cellIndex(segment.x, segment.y));
+        }
+    }
+    reserved.set(cellIndex(foodX, foodY));
+    if (bananaActive) {
+        reserved.set(cellIndex(bananaX, bananaY));
+    }
+    reserveCellsAhead(reserved, snake.front(), direction);
+
+    // Drop stones on reserved cells, then any stones walling off part of the board from the head
+    CellGrid conflicts = reserved;
+    const int headIndex = cellIndex(snake.front().x, snake.front().y);
+    while (true) {
+        size_t kept = 0;
+        for (const auto& obstacle : obstacles) {
+            if ((buildObstacleGrid({ obstacle }) & conflicts).none()) {
+                obstacles[kept++] = obstacle;
+            }
+        }
+        bool removed = kept < obstacles.size();
+        obstacles.resize(kept);
+
+        CellGrid freeCells = ~buildObstacleGrid(obstacles);
+        CellGrid unreachable = freeCells & ~floodFill(freeCells, headIndex);
+        if (unreachable.none() || (!removed && conflicts == dilateCells(unreachable))) {
+            break; // Connected, or nothing left that could be opened up
+        }
+        conflicts = dilateCells(unreachable);
+    }
+    for (const auto& obstacle : obstacles) {
+        hashObstacle(stateHash, obstacle);
+    }
+}
+
+// Function to create a random snake of three segments on free cells, clear of the other random snakes,
+// the food, the banana and the cells just ahead of the player
+RandomSnake spawnRandomSnake(EnemyBehavior behavior, const CellGrid& obstacleGrid, const std::vector<SnakeSegment>& snake,
+                             const std::vector<RandomSnake>& randomSnakes, Direction direction, int foodX, int foodY,
+                             bool bananaActive, int bananaX, int bananaY, std::mt19937& rng, Uint64& stateHash) {
+    CellGrid reserved = obstacleGrid;
+    for (const auto& segment : snake) {
+        reserved.set(cellIndex(segment.x, segment.y));
+    }
+    for (const auto& other : randomSnakes) {
+        for (const auto& segment : other.segments) {
+            reserved.set(cellIndex(segment.x, segment.y));
+        }
+    }
+    if (foodX >= 0) {
+        reserved.set(cellIndex(foodX, foodY));
+    }
+    if (bananaActive) {
+        reserved.set(cellIndex(bananaX, bananaY));
+    }
+    reserveCellsAhead(reserved, snake.front(), direction);
+
+    RandomSnake randomSnake;
+    bool validPosition = false;
+    while (!validPosition) {
+        validPosition = true;
+        int startX = static_cast<int>(rng() % (GRID_COLS - 2)) * SNAKE_SIZE;
+        int startY = static_cast<int>(rng() % GRID_ROWS) * SNAKE_SIZE;
+        randomSnake.segments.clear();
+        for (int i = 0; i < 3; ++i) {
+            SnakeSegment segment = { startX + i * SNAKE_SIZE, startY };
+            if (reserved.test(cellIndex(segment.x, segment.y))) {
                 validPosition = false;
-                break;
             }
+            randomSnake.segments.push_back(segment);
         }
     }
+    randomSnake.direction = LEFT; // Head first, away from the body
+    randomSnake.moveInterval = 500; // Interval between movements in milliseconds
+    randomSnake.behavior = behavior;
+    for (const auto& segment : randomSnake.segments) {
+        hashCell(stateHash, RANDOM_SNAKE_CELL, segment.x, segment.y);
+    }
+    return randomSnake;
 }
 
-// Function to generate obstacles
-void generateObstacles(std::vector<SDL_Rect>& obstacles, const std::vector<SnakeSegment>& snake) {
-    int numObstacles = 3; // Number of obstacles to generate
-    obstacles.clear();
-    for (int i = 0; i < numObstacles; ++i) {
-        SDL_Rect newObstacle;
-        bool validPosition = false;
-        while (!validPosition) {
-            validPosition = true;
-            newObstacle.x = (rand() % (SCREEN_WIDTH / OBSTACLE_SIZE)) * OBSTACLE_SIZE;
-            newObstacle.y = (rand() % (SCREEN_HEIGHT / OBSTACLE_SIZE)) * OBSTACLE_SIZE;
-            newObstacle.w = OBSTACLE_SIZE;
-            newObstacle.h = OBSTACLE_SIZE;
-            for (const auto& segment : snake) {
-                if (segment.x == newObstacle.x && segment.y == newObstacle.y) {
-                    validPosition = false;
-                    break;
-                }
+// Function to step one cell in a direction, wrapping at the screen edges like the random snakes do
+SnakeSegment wrappedStep(SnakeSegment position, Direction direction) {
+    switch (direction) {
+        case UP: position.y -= SNAKE_SIZE; break;
+        case DOWN: position.y += SNAKE_SIZE; break;
+        case LEFT: position.x -= SNAKE_SIZE; break;
+        case RIGHT: position.x += SNAKE_SIZE; break;
+    }
+    if (position.x < 0) position.x = SCREEN_WIDTH - SNAKE_SIZE;
+    else if (position.x >= SCREEN_WIDTH) position.x = 0;
+    if (position.y < 0) position.y = SCREEN_HEIGHT - SNAKE_SIZE;
+    else if (position.y >= SCREEN_HEIGHT) position.y = 0;
+    return position;
+}
+
+// Function to refresh a distance field with a wrapping BFS, only if the target or the obstacles changed
+void updateDistanceField(DistanceField& field, const CellGrid& obstacleGrid, int targetIndex) {
+    if (field.targetIndex == targetIndex && field.blocked == obstacleGrid) {
+        return;
+    }
+    field.targetIndex = targetIndex;
+    field.blocked = obstacleGrid;
+    field.distance.assign(GRID_COLS * GRID_ROWS, -1);
+    if (obstacleGrid.test(targetIndex)) {
+        return;
+    }
+
+    static std::vector<int> queue(GRID_COLS * GRID_ROWS);
+    size_t head = 0, tail = 0;
+    field.distance[targetIndex] = 0;
+    queue[tail++] = targetIndex;
+    while (head < tail) {
+        int index = queue[head++];
+        SnakeSegment cell = { (index % GRID_COLS) * SNAKE_SIZE, (index / GRID_COLS) * SNAKE_SIZE };
+        for (int d = 0; d < 4; ++d) {
+            SnakeSegment next = wrappedStep(cell, static_cast<Direction>(d));
+            int nextIndex = cellIndex(next.x, next.y);
+            if (field.distance[nextIndex] == -1 && !obstacleGrid.test(nextIndex)) {
+                field.distance[nextIndex] = field.distance[index] + 1;
+                queue[tail++] = nextIndex;
             }
-            for (const auto& obstacle : obstacles) {
-                if (obstacle.x == newObstacle.x && obstacle.y == newObstacle.y) {
-                    validPosition = false;
-                    break;
-                }
+        }
+    }
+}
+
+// Function to pick the next direction of a random snake according to its behavior; blockedCells holds the
+// obstacles and the other random snakes
+Direction chooseRandomSnakeDirection(const RandomSnake& randomSnake, const CellGrid& blockedCells,
+                                     const DistanceField& playerField, const DistanceField& foodField, std::mt19937& rng) {
+    const int guardRadius = 4; // Cells a food guard may stray from the food
+    const int unreachable = GRID_COLS * GRID_ROWS;
+    const Direction opposite[4] = { DOWN, UP, RIGHT, LEFT };
+    const SnakeSegment& head = randomSnake.segments.front();
+
+    Direction best = randomSnake.direction;
+    int bestScore = 0;
+    bool found = false;
+    for (int d = 0; d < 4; ++d) {
+        Direction candidate = static_cast<Direction>(d);
+        if (candidate == opposite[randomSnake.direction]) {
+            continue;
+        }
+        SnakeSegment next = wrappedStep(head, candidate);
+        int nextIndex = cellIndex(next.x, next.y);
+        if (blockedCells.test(nextIndex)) {
+            continue;
+        }
+        bool selfCollision = false;
+        for (size_t i = 0; i + 1 < randomSnake.segments.size(); ++i) { // The tail moves out of the way
+            if (randomSnake.segments[i].x == next.x && randomSnake.segments[i].y == next.y) {
+                selfCollision = true;
             }
         }
-        obstacles.push_back(newObstacle);
+        if (selfCollision) {
+            continue;
+        }
+
+        // Lower scores are better; the random part breaks ties and makes wandering turns
+        int score = static_cast<int>(rng() % 4);
+        if (candidate == randomSnake.direction) {
+            score -= 2; // Prefer going straight over turning
+        }
+        int toPlayer = playerField.distance.empty() || playerField.distance[nextIndex] < 0 ? unreachable : playerField.distance[nextIndex];
+        int toFood = foodField.distance.empty() || foodField.distance[nextIndex] < 0 ? unreachable : foodField.distance[nextIndex];
+        switch (randomSnake.behavior) {
+            case WANDER: break;
+            case CHASE: score += toPlayer * 8; break;
+            case AVOID: score -= toPlayer * 8; break;
+            case GUARD_FOOD: score += (toFood > guardRadius ? toFood : guardRadius) * 8; break;
+        }
+        if (!found || score < bestScore) {
+            best = candidate;
+            bestScore = score;
+            found = true;
+        }
+    }
+    return best;
+}
+
+// Function to move a random snake by one cell when its move timer fires. The distance fields are shared
+// by all random snakes and only recomputed when their target moved, so the cost per enemy stays constant.
+void moveRandomSnake(RandomSnake& randomSnake, const std::vector<RandomSnake>& randomSnakes, const CellGrid& obstacleGrid,
+                     DistanceField& playerField, DistanceField& foodField, const SnakeSegment& playerHead, int foodX, int foodY,
+                     std::mt19937& rng, Uint64& stateHash) {
+    if (randomSnake.behavior == CHASE || randomSnake.behavior == AVOID) {
+        if (playerHead.x >= 0 && playerHead.x < SCREEN_WIDTH && playerHead.y >= 0 && playerHead.y < SCREEN_HEIGHT) {
+            updateDistanceField(playerField, obstacleGrid, cellIndex(playerHead.x, playerHead.y));
+        }
+    } else if (randomSnake.behavior == GUARD_FOOD) {
+        updateDistanceField(foodField, obstacleGrid, cellIndex(foodX, foodY));
+    }
+
+    // Random snakes never move into each other
+    CellGrid blockedCells = obstacleGrid;
+    for (const auto& other : randomSnakes) {
+        if (&other != &randomSnake) {
+            for (const auto& segment : other.segments) {
+                blockedCells.set(cellIndex(segment.x, segment.y));
+            }
+        }
+    }
+
+    randomSnake.direction = chooseRandomSnakeDirection(randomSnake, blockedCells, playerField, foodField, rng);
+    SnakeSegment newHead = wrappedStep(randomSnake.segments.front(), randomSnake.direction);
+    if (!blockedCells.test(cellIndex(newHead.x, newHead.y))) { // Only stalls when boxed in on all sides
+        randomSnake.segments.insert(randomSnake.segments.begin(), newHead);
+        hashCell(stateHash, RANDOM_SNAKE_CELL, newHead.x, newHead.y);
+        hashCell(stateHash, RANDOM_SNAKE_CELL, randomSnake.segments.back().x, randomSnake.segments.back().y);
+        randomSnake.segments.pop_back();
+    }
+}
+
+// Function to link a timer node into the wheel slot matching how far away its expiry is
+void insertTimerNode(TimerWheel& wheel, int index) {
+    TimerWheel::Node& node = wheel.nodes[index];
+    Uint32 delta = node.expires - wheel.now;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1u << (TIMER_WHEEL_BITS * (level + 1)))) {
+        ++level;
+    }
+    int slot = (node.expires >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+    int head = level * TIMER_WHEEL_SLOTS + slot;
+
+    // Append so timers in a slot fire in the order they were scheduled
+    node.prev = wheel.nodes[head].prev;
+    node.next = head;
+    wheel.nodes[node.prev].next = index;
+    wheel.nodes[head].prev = index;
+}
+
+// Function to unlink a timer node from its slot
+void unlinkTimerNode(TimerWheel& wheel, int index) {
+    TimerWheel::Node& node = wheel.nodes[index];
+    wheel.nodes[node.prev].next = node.next;
+    wheel.nodes[node.next].prev = node.prev;
+    node.prev = node.next = index;
+}
+
+// Function to schedule an event delayMs of game time from now (rounded up to TIMER_RESOLUTION_MS)
+TimerHandle scheduleTimer(TimerWheel& wheel, TimerEventType type, int data, Uint32 delayMs) {
+    if (wheel.nodes.empty()) {
+        // Create the empty slot lists: every head starts out linked to itself
+        wheel.nodes.resize(TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS);
+        for (size_t i = 0; i < wheel.nodes.size(); ++i) {
+            wheel.nodes[i].prev = wheel.nodes[i].next = static_cast<int>(i);
+        }
+    }
+    int index;
+    if (!wheel.freeNodes.empty()) {
+        index = wheel.freeNodes.back();
+        wheel.freeNodes.pop_back();
+    } else {
+        index = static_cast<int>(wheel.nodes.size());
+        wheel.nodes.push_back(TimerWheel::Node());
+        wheel.nodes[index].generation = 0;
+    }
+
+    const Uint32 maxDelay = (1u << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+    Uint32 delay = (delayMs + TIMER_RESOLUTION_MS - 1) / TIMER_RESOLUTION_MS;
+    if (delay == 0) {
+        delay = 1; // Fires on the next slot, never during the current one
+    } else if (delay > maxDelay) {
+        delay = maxDelay;
+    }
+    TimerWheel::Node& node = wheel.nodes[index];
+    node.event = { type, data };
+    node.expires = wheel.now + delay;
+    node.pending = true;
+    insertTimerNode(wheel, index);
+
+    TimerHandle handle;
+    handle.index = index;
+    handle.generation = node.generation;
+    return handle;
+}
+
+// Function to check if a timer is still waiting to fire
+bool isTimerPending(const TimerWheel& wheel, const TimerHandle& handle) {
+    return handle.index >= 0 && handle.index < static_cast<int>(wheel.nodes.size()) &&
+           wheel.nodes[handle.index].generation == handle.generation && wheel.nodes[handle.index].pending;
+}
+
+// Function to return a timer node to the pool
+void releaseTimerNode(TimerWheel& wheel, int index) {
+    wheel.nodes[index].pending = false;
+    wheel.nodes[index].generation++;
+    wheel.freeNodes.push_back(index);
+}
+
+// Function to cancel a pending timer; does nothing if it already fired or was cancelled
+void cancelTimer(TimerWheel& wheel, TimerHandle& handle) {
+    if (isTimerPending(wheel, handle)) {
+        unlinkTimerNode(wheel, handle.index);
+        releaseTimerNode(wheel, handle.index);
+    }
+    handle = TimerHandle();
+}
+
+// Function to get the game time left until a pending timer fires, in milliseconds
+Uint32 timerRemaining(const TimerWheel& wheel, const TimerHandle& handle) {
+    if (!isTimerPending(wheel, handle)) {
+        return 0;
+    }
+    return (wheel.nodes[handle.index].expires - wheel.now) * TIMER_RESOLUTION_MS;
+}
+
+// Function to advance the wheel to gameTimeMs, appending the events of expired timers in expiry order
+void advanceTimers(TimerWheel& wheel, Uint32 gameTimeMs, std::vector<TimerEvent>& firedEvents) {
+    if (wheel.nodes.empty()) {
+        wheel.now = gameTimeMs / TIMER_RESOLUTION_MS;
+        return;
+    }
+    const Uint32 target = gameTimeMs / TIMER_RESOLUTION_MS;
+    while (wheel.now != target) {
+        wheel.now++;
+
+        // Each time a level wraps around, move the timers of the next slot of the level above down
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; ++level) {
+            if ((wheel.now & ((1u << (TIMER_WHEEL_BITS * level)) - 1)) != 0) {
+                break;
+            }
+            int head = level * TIMER_WHEEL_SLOTS + ((wheel.now >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1));
+            while (wheel.nodes[head].next != head) {
+                int index = wheel.nodes[head].next;
+                unlinkTimerNode(wheel, index);
+                insertTimerNode(wheel, index);
+            }
+        }
+
+        int head = wheel.now & (TIMER_WHEEL_SLOTS - 1);
+        while (wheel.nodes[head].next != head) {
+            int index = wheel.nodes[head].next;
+            unlinkTimerNode(wheel, index);
+            firedEvents.push_back(wheel.nodes[index].event);
+            releaseTimerNode(wheel, index);
+        }
     }
 }
 
 // Function to handle events
-void handleEvents(SDL_Event& e, Direction& direction, bool& quit, GameState& state) {
+void handleEvents(SDL_Event& e, Direction& direction, bool& quit, GameState& state, SDL_Window* window, bool& displayChanged) {
     while (SDL_PollEvent(&e) != 0) {
         if (e.type == SDL_QUIT) {
             quit = true;
+        } else if (e.type == SDL_WINDOWEVENT) {
+            if (e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED || e.window.event == SDL_WINDOWEVENT_DISPLAY_CHANGED) {
+                displayChanged = true; // Pixel scale may have changed
+            }
         } else if (e.type == SDL_KEYDOWN) {
             switch (e.key.keysym.sym) {
                 case SDLK_UP: if (direction != DOWN) direction = UP; break;
@@ -633,6 +1889,9 @@ void handleEvents(SDL_Event& e, Direction& direction, bool& quit, GameState& sta
                 case SDLK_RIGHT: if (direction != LEFT) direction = RIGHT; break;
                 case SDLK_p: if (state == PLAYING) state = PAUSED; else if (state == PAUSED) state = PLAYING; break; // Toggle pause state
                 case SDLK_RETURN: if (state == MENU) state = PLAYING; break; // Start game from menu
+                case SDLK_F11: // Toggle fullscreen
+                    SDL_SetWindowFullscreen(window, (SDL_GetWindowFlags(window) & SDL_WINDOW_FULLSCREEN_DESKTOP) ? 0 : SDL_WINDOW_FULLSCREEN_DESKTOP);
+                    break;
             }
         }
     }
@@ -643,26 +1902,77 @@ int main(int argc, char* args[]) {
     SDL_Renderer* renderer = nullptr;
     TTF_Font* font = nullptr;
 
-    if (!init(window, renderer, font)) {
+    // Parse command line options: --seed N reproduces a run, --density P sets the obstacle density in percent
+    // (clamped to 0-100; the connectivity rule caps real layouts at roughly 54-68% of the slots),
+    // --fullscreen starts in desktop fullscreen, --framebuffer draws the playfield into a CPU pixel buffer,
+    // --software-renderer forces SDL's software renderer (to benchmark both paths without a GPU),
+    // --benchmark prints the average render time every few hundred frames,
+    // --assets DIR adds a directory whose files override the embedded assets, --capture FILE records to a Y4M video,
+    // --hash-log FILE writes state hash checkpoints and --verify-hashes FILE checks a run against them
+    unsigned int seed = static_cast<unsigned int>(time(nullptr));
+    int obstacleDensity = DEFAULT_OBSTACLE_DENSITY;
+    bool fullscreen = false;
+    bool useFramebuffer = false;
+    bool softwareRenderer = false;
+    bool benchmark = false;
+    std::vector<std::string> assetPaths;
+    std::string capturePath;
+    std::string hashLogPath;
+    std::string verifyHashesPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = args[i];
+        if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<unsigned int>(std::strtoul(args[++i], nullptr, 10));
+        } else if (arg == "--density" && i + 1 < argc) {
+            obstacleDensity = std::atoi(args[++i]);
+            if (obstacleDensity < 0) {
+                obstacleDensity = 0;
+            } else if (obstacleDensity > MAX_OBSTACLE_DENSITY) {
+                obstacleDensity = MAX_OBSTACLE_DENSITY;
+            }
+        } else if (arg == "--fullscreen") {
+            fullscreen = true;
+        } else if (arg == "--framebuffer") {
+            useFramebuffer = true;
+        } else if (arg == "--software-renderer") {
+            softwareRenderer = true;
+        } else if (arg == "--benchmark") {
+            benchmark = true;
+        } else if (arg == "--assets" && i + 1 < argc) {
+            assetPaths.push_back(args[++i]);
+        } else if (arg == "--capture" && i + 1 < argc) {
+            capturePath = args[++i];
+        } else if (arg == "--hash-log" && i + 1 < argc) {
+            hashLogPath = args[++i];
+        } else if (arg == "--verify-hashes" && i + 1 < argc) {
+            verifyHashesPath = args[++i];
+        }
+    }
+    initAssetPaths(assetPaths);
+
+    if (!init(window, renderer, font, fullscreen, softwareRenderer)) {
         std::cerr << "Failed to initialize!" << std::endl;
         return 1;
     }
 
-    if (!loadMedia(renderer)) {
+    if (!loadMedia(renderer) || (useFramebuffer && !initFramebuffer(renderer))) {
         std::cerr << "Failed to load media!" << std::endl;
         close(window, renderer, font);
         return 1;
     }
 
-    srand(static_cast<unsigned int>(time(nullptr)));
+    std::cerr << "Seed: " << seed << "\n"; // Replay this run with --seed
+
+    // Every game-logic draw comes from this generator as raw std::mt19937 output, so a seed replays the same
+    // game on every platform (rand() and the standard distributions differ between standard libraries)
+    std::mt19937 gameRng(seed);
 
     // Initialize game variables
     std::vector<SnakeSegment> snake = { {SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2} };
     Direction direction = RIGHT;
     bool grow = false;
-    int foodX, foodY;
-    int bananaX, bananaY;
-    Uint32 bananaSpawnTime = 0;
+    int foodX = -1, foodY = -1;
+    int bananaX = -1, bananaY = -1;
     bool bananaActive = false;
     const Uint32 bananaLifetime = 5000; // Banana lifetime in milliseconds
     std::vector<SDL_Rect> obstacles; // Vector to store obstacles
@@ -672,184 +1982,289 @@ int main(int argc, char* args[]) {
     int initialSnakeSpeed = 130; // Initial snake speed
     int snakeSpeed = initialSnakeSpeed;
     int maxSnakeSpeed = 50; // Minimum delay (maximum speed)
-    Uint32 levelUpStartTime = 0; // Time when the level up message was shown
     SDL_Event e;
+    FrameStats frameStats; // Render timing of PLAYING frames and capture overhead
+    bool displayChanged = false; // Set when the window is resized or moved to another display
     int pointsSinceLastBanana = 0; // Points since the last banana appeared
     bool levelUpTriggered = false; // Track if level up has been triggered
     std::string currentLevel = "level 1"; // Track the current level
 
-    // Initialize random snake with random positions
-    RandomSnake randomSnake;
-    randomSnake.segments.clear();
-    int startX = (rand() % (SCREEN_WIDTH / SNAKE_SIZE)) * SNAKE_SIZE;
-    int startY = (rand() % (SCREEN_HEIGHT / SNAKE_SIZE)) * SNAKE_SIZE;
-    for (int i = 0; i < 3; ++i) {
-        randomSnake.segments.push_back({ startX + i * SNAKE_SIZE, startY });
+    // State hash, kept up to date as the state changes and checkpointed every HASH_CHECKPOINT_INTERVAL ticks and at game over
+    initHashKeys();
+    Uint64 stateHash = computeStateHash(snake, {}, {}, foodX, foodY, false, bananaX, bananaY, score, currentLevel, direction);
+    Direction hashedDirection = direction; // Direction currently included in the hash
+    Uint32 simulationTick = 0;
+    std::ofstream hashLog;
+    if (!hashLogPath.empty()) {
+        hashLog.open(hashLogPath);
     }
-    randomSnake.direction = static_cast<Direction>(rand() % 4);
-    randomSnake.lastMoveTime = SDL_GetTicks();
-    randomSnake.moveInterval = 500; // Interval between movements in milliseconds
+    std::ifstream expectedHashes;
+    if (!verifyHashesPath.empty()) {
+        expectedHashes.open(verifyHashesPath);
+    }
+    bool desyncReported = false;
+
+    // Initialize random snakes: a wanderer that starts moving at level 2 and turns to guarding the food at level 3,
+    // when a chaser joins
+    CellGrid obstacleGrid; // Cells covered by obstacles, rebuilt whenever obstacles change
+    std::vector<RandomSnake> randomSnakes;
+    randomSnakes.push_back(spawnRandomSnake(WANDER, obstacleGrid, snake, randomSnakes, direction, foodX, foodY, bananaActive, bananaX, bananaY, gameRng, stateHash));
     bool randomSnakeActive = false;
+    DistanceField playerField; // Distances to the player's head, shared by all random snakes
+    DistanceField foodField;   // Distances to the food, shared by all random snakes
+
+    // Timer variables: timed events run on game time, which only advances while the game is simulated
+    TimerWheel timers;
+    std::vector<TimerEvent> firedEvents;
+    Uint32 gameTime = 0; // Milliseconds of simulated game time
+    TimerHandle bananaTimer;
+    TimerHandle countdownTimer;
+    const Uint32 levelUpDuration = 3000; // Level up message duration in milliseconds
+    const Uint32 countdownDuration = 3000; // Countdown duration in milliseconds
 
+    // Start the sound effects
+    AudioEngine audio;
+    startAudio(audio);
 
-    // Timer variables
-    Uint32 countdownStartTime = 0;
-    const Uint32 countdownDuration = 3000; // Countdown duration in milliseconds
-    bool countdownActive = false;
+    // Start recording if requested; the game runs on without it if the file cannot be opened
+    VideoCapture capture;
+    if (!capturePath.empty()) {
+        startCapture(capture, renderer, capturePath);
+    }
 
     // Generate initial food position
-    generateFood(foodX, foodY, snake, obstacles, randomSnake);
+    generateFood(foodX, foodY, snake, obstacles, randomSnakes, gameRng, stateHash);
     std::cout << "Initial Food Position: (" << foodX << ", " << foodY << ")\n"; // Debug print
 
     // Main game loop
     while (!quit) {
-        handleEvents(e, direction, quit, state);
+        handleEvents(e, direction, quit, state, window, displayChanged);
+
+        // Regenerate the font glyphs at the new pixel scale, once per change rather than every frame
+        if (displayChanged) {
+            displayChanged = false;
+            TTF_Font* scaledFont = openScaledFont(renderer);
+            if (scaledFont) {
+                TTF_CloseFont(font);
+                font = scaledFont;
+            }
+        }
+
+        // Handle the timed events that came due
+        firedEvents.clear();
+        advanceTimers(timers, gameTime, firedEvents);
+        for (const auto& event : firedEvents) {
+            switch (event.type) {
+                case BANANA_EXPIRED:
+                    bananaActive = false; // Remove banana after its lifetime
+                    hashCell(stateHash, BANANA_CELL, bananaX, bananaY);
+                    break;
+                case LEVEL_UP_FINISHED:
+                    state = COUNTDOWN; // Move to the countdown state
+                    countdownTimer = scheduleTimer(timers, COUNTDOWN_FINISHED, 0, countdownDuration);
+                    playSound(audio, SOUND_COUNTDOWN);
+                    for (Uint32 beepTime = 1000; beepTime < countdownDuration; beepTime += 1000) {
+                        scheduleTimer(timers, COUNTDOWN_BEEP, 0, beepTime); // Beep every remaining second
+                    }
+                    break;
+                case COUNTDOWN_BEEP:
+                    playSound(audio, SOUND_COUNTDOWN);
+                    break;
+                case COUNTDOWN_FINISHED:
+                    state = PLAYING;
+                    levelUpTriggered = false; // Reset level-up trigger
+                    break;
+                case RANDOM_SNAKE_MOVE: {
+                    RandomSnake& randomSnake = randomSnakes[event.data];
+                    if (state == PLAYING) { // Random snakes hold still during level up and countdown
+                        moveRandomSnake(randomSnake, randomSnakes, obstacleGrid, playerField, foodField, snake.front(), foodX, foodY, gameRng, stateHash);
+                    }
+                    scheduleTimer(timers, RANDOM_SNAKE_MOVE, event.data, randomSnake.moveInterval);
+                    break;
+                }
+            }
+        }
 
         if (state == PLAYING) {
             // Update game logic
-            Uint32 currentTime = SDL_GetTicks();
-            updateSnake(snake, direction, grow);
+            if (direction != hashedDirection) {
+                stateHash ^= directionHashKeys[hashedDirection] ^ directionHashKeys[direction];
+                hashedDirection = direction;
+            }
+            updateSnake(snake, direction, grow, stateHash);
 
             if (checkFoodCollision(foodX, foodY, snake.front())) {
                 grow = true;
-                score++;
+                addScore(score, 1, stateHash);
+                playSound(audio, SOUND_EAT_APPLE);
                 pointsSinceLastBanana++;
-                generateFood(foodX, foodY, snake, obstacles, randomSnake);
+                generateFood(foodX, foodY, snake, obstacles, randomSnakes, gameRng, stateHash);
                 std::cout << "New Food Position: (" << foodX << ", " << foodY << ")\n"; // Debug print
 
                 // Trigger level up at specific scores
                 if (!levelUpTriggered && score >= 8 && currentLevel == "level 1") {
                     state = LEVEL_UP;
-                    levelUpStartTime = SDL_GetTicks();
+                    playSound(audio, SOUND_LEVEL_UP);
+                    scheduleTimer(timers, LEVEL_UP_FINISHED, 0, levelUpDuration);
                     levelUpTriggered = true;
+                    hashLevel(stateHash, currentLevel);
                     currentLevel = "level 2"; // Move to level 2
+                    hashLevel(stateHash, currentLevel);
                 } else if (!levelUpTriggered && score >= 15 && currentLevel == "level 2") {
                     state = LEVEL_UP;
-                    levelUpStartTime = SDL_GetTicks();
-                    generateObstacles(obstacles, snake); // Generate obstacles on level up
+                    playSound(audio, SOUND_LEVEL_UP);
+                    scheduleTimer(timers, LEVEL_UP_FINISHED, 0, levelUpDuration);
+                    generateObstacles(obstacles, snake, direction, randomSnakes, foodX, foodY, bananaActive, bananaX, bananaY, seed, obstacleDensity, stateHash); // Generate obstacles on level up
+                    obstacleGrid = buildObstacleGrid(obstacles);
+                    randomSnakes.push_back(spawnRandomSnake(CHASE, obstacleGrid, snake, randomSnakes, direction, foodX, foodY, bananaActive, bananaX, bananaY, gameRng, stateHash)); // A second viper hunts the player
+                    randomSnakes.front().behavior = GUARD_FOOD; // The wanderer starts circling the food
+                    scheduleTimer(timers, RANDOM_SNAKE_MOVE, static_cast<int>(randomSnakes.size() - 1), randomSnakes.back().moveInterval);
                     levelUpTriggered = true;
+                    hashLevel(stateHash, currentLevel);
                     currentLevel = "level 3"; // Move to level 3
+                    hashLevel(stateHash, currentLevel);
                 }
 
                 // Activate random snake at level 2
-                if (currentLevel == "level 2") {
+                if (currentLevel == "level 2" && !randomSnakeActive) {
                     randomSnakeActive = true;
+                    for (size_t i = 0; i < randomSnakes.size(); ++i) {
+                        scheduleTimer(timers, RANDOM_SNAKE_MOVE, static_cast<int>(i), randomSnakes[i].moveInterval);
+                    }
                 }
             }
 
             if (bananaActive && checkBananaCollision(bananaX, bananaY, snake.front())) {
                 grow = true;
-                score += 3;
+                addScore(score, 3, stateHash);
+                playSound(audio, SOUND_EAT_BANANA);
                 bananaActive = false; // Remove banana after being eaten
+                hashCell(stateHash, BANANA_CELL, bananaX, bananaY);
+                cancelTimer(timers, bananaTimer);
                 pointsSinceLastBanana = 0;
             }
 
-            if (checkCollision(snake, obstacles) || (randomSnakeActive && checkRandomSnakeCollision(snake, randomSnake))) {
+            if (checkCollision(snake, obstacles)) {
                 state = GAME_OVER;
             }
+            for (const auto& randomSnake : randomSnakes) {
+                if (randomSnakeActive && checkRandomSnakeCollision(snake, randomSnake)) {
+                    state = GAME_OVER;
+                }
+            }
+            if (state == GAME_OVER) {
+                playSound(audio, SOUND_COLLISION);
+            }
 
             // Adjust snake speed based on its length
             snakeSpeed = customMax(maxSnakeSpeed, initialSnakeSpeed - (snake.size() - 1) * 5);
 
             // Generate banana if score is 5 and banana is not active
             if (score >= 5 && pointsSinceLastBanana >= 3 && !bananaActive) {
-                generateBanana(bananaX, bananaY, snake, obstacles, randomSnake);
-                bananaSpawnTime = SDL_GetTicks();
+                generateBanana(bananaX, bananaY, snake, obstacles, randomSnakes, gameRng, stateHash);
+                bananaTimer = scheduleTimer(timers, BANANA_EXPIRED, 0, bananaLifetime); // Remove banana after 5 seconds
                 bananaActive = true;
             }
 
-            // Remove banana after 5 seconds
-            if (bananaActive && SDL_GetTicks() - bananaSpawnTime >= bananaLifetime) {
-                bananaActive = false;
-            }
-
-            // Update random snake
-            if (randomSnakeActive) {
-                updateRandomSnake(randomSnake, obstacles, currentTime);
+            // Checkpoint the state hash for replays and tournament runs, and once more on the final state
+            simulationTick++;
+            if ((simulationTick % HASH_CHECKPOINT_INTERVAL == 0 || state == GAME_OVER) && (hashLog.is_open() || expectedHashes.is_open())) {
+                Uint64 recomputedHash = computeStateHash(snake, randomSnakes, obstacles, foodX, foodY, bananaActive,
+                                                         bananaX, bananaY, score, currentLevel, direction);
+                checkpointStateHash(simulationTick, stateHash, recomputedHash, hashLog, expectedHashes, desyncReported);
             }
 
             // Render game
-            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-            SDL_RenderClear(renderer);
-            SDL_RenderCopy(renderer, backgroundTexture, nullptr, nullptr);
-            renderSnake(renderer, snake);
-            renderFood(renderer, foodX, foodY);
-            if (bananaActive) {
-                renderBanana(renderer, bananaX, bananaY); // Render banana if active
-                renderBananaTimer(renderer, font, bananaSpawnTime, bananaLifetime); // Render banana timer if active
+            Uint64 renderStart = SDL_GetPerformanceCounter();
+            if (useFramebuffer) {
+                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+                SDL_RenderClear(renderer);
+                renderFramebufferPlayfield(renderer, snake, foodX, foodY, bananaActive, bananaX, bananaY, obstacles, randomSnakes, randomSnakeActive);
+                if (bananaActive) {
+                    renderBananaTimer(renderer, font, timerRemaining(timers, bananaTimer)); // Render banana timer if active
+                }
+                renderScore(renderer, font, score);
+            } else {
+                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+                SDL_RenderClear(renderer);
+                SDL_RenderCopy(renderer, backgroundTexture, nullptr, nullptr);
+                renderSnake(renderer, snake);
+                renderFood(renderer, foodX, foodY);
+                if (bananaActive) {
+                    renderBanana(renderer, bananaX, bananaY); // Render banana if active
+                    renderBananaTimer(renderer, font, timerRemaining(timers, bananaTimer)); // Render banana timer if active
+                }
+                renderObstacles(renderer, obstacles); // Render obstacles
+                renderScore(renderer, font, score);
+                if (randomSnakeActive) {
+                    for (const auto& randomSnake : randomSnakes) {
+                        renderRandomSnake(renderer, randomSnake); // Render random snakes if active
+                    }
+                }
             }
-            renderObstacles(renderer, obstacles); // Render obstacles
-            renderScore(renderer, font, score);
-            if (randomSnakeActive) {
-                renderRandomSnake(renderer, randomSnake); // Render random snake if active
+            Uint64 captureTicks = presentFrame(renderer, capture, frameStats); // Ensure rendering during PLAYING state
+            if (benchmark) {
+                recordFrameStats(frameStats, renderStart, captureTicks, useFramebuffer);
             }
-            SDL_RenderPresent(renderer); // Ensure rendering during PLAYING state
 
         } else if (state == LEVEL_UP) {
             // Render level up message
+            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
             SDL_RenderClear(renderer);
             SDL_RenderCopy(renderer, backgroundTexture, nullptr, nullptr);
             renderLevelUp(renderer, font, currentLevel);
-            SDL_RenderPresent(renderer);
-
-            // Start the countdown timer after displaying the level-up message
-            if (!countdownActive) {
-                countdownStartTime = SDL_GetTicks();
-                countdownActive = true;
-            }
-
-            // Check if the level up message should disappear
-            Uint32 currentTime = SDL_GetTicks();
-            if (countdownActive && currentTime - countdownStartTime >= 3000) { // Show level-up message for 3 seconds
-                countdownActive = false;
-                state = COUNTDOWN; // Move to the countdown state
-                countdownStartTime = SDL_GetTicks(); // Restart the countdown for the new state
-            }
+            presentFrame(renderer, capture, frameStats);
 
         } else if (state == COUNTDOWN) {
             // Render game elements
-            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-            SDL_RenderClear(renderer);
-            SDL_RenderCopy(renderer, backgroundTexture, nullptr, nullptr);
-            renderSnake(renderer, snake);
-            renderFood(renderer, foodX, foodY);
-            if (bananaActive) {
-                renderBanana(renderer, bananaX, bananaY); // Render banana if active
-            }
-            renderObstacles(renderer, obstacles); // Render obstacles
-            renderScore(renderer, font, score);
-            if (randomSnakeActive) {
-                renderRandomSnake(renderer, randomSnake); // Render random snake if active
+            if (useFramebuffer) {
+                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+                SDL_RenderClear(renderer);
+                renderFramebufferPlayfield(renderer, snake, foodX, foodY, bananaActive, bananaX, bananaY, obstacles, randomSnakes, randomSnakeActive);
+                renderScore(renderer, font, score);
+            } else {
+                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+                SDL_RenderClear(renderer);
+                SDL_RenderCopy(renderer, backgroundTexture, nullptr, nullptr);
+                renderSnake(renderer, snake);
+                renderFood(renderer, foodX, foodY);
+                if (bananaActive) {
+                    renderBanana(renderer, bananaX, bananaY); // Render banana if active
+                }
+                renderObstacles(renderer, obstacles); // Render obstacles
+                renderScore(renderer, font, score);
+                if (randomSnakeActive) {
+                    for (const auto& randomSnake : randomSnakes) {
+                        renderRandomSnake(renderer, randomSnake); // Render random snakes if active
+                    }
+                }
             }
 
             // Render the countdown timer
-            renderCountdownTimer(renderer, font, countdownStartTime, countdownDuration);
-            SDL_RenderPresent(renderer);
-
-            // Check if the countdown has finished
-            Uint32 currentTime = SDL_GetTicks();
-            if (currentTime - countdownStartTime >= countdownDuration) { // Countdown duration in milliseconds
-                state = PLAYING;
-                levelUpTriggered = false; // Reset level-up trigger
-            }
+            renderCountdownTimer(renderer, font, timerRemaining(timers, countdownTimer));
+            presentFrame(renderer, capture, frameStats);
 
         } else if (state == GAME_OVER) {
             // Render game over text box over the main background
+            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+            SDL_RenderClear(renderer);
             SDL_RenderCopy(renderer, backgroundTexture, nullptr, nullptr);
             renderSnake(renderer, snake);
             renderFood(renderer, foodX, foodY);
             renderScore(renderer, font, score);
             renderGameOver(renderer, font, score);
-            SDL_RenderPresent(renderer); // Ensure rendering during GAME_OVER state
+            presentFrame(renderer, capture, frameStats); // Ensure rendering during GAME_OVER state
 
         } else if (state == PAUSED) {
             // Render pause text box over the main background
+            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+            SDL_RenderClear(renderer);
             SDL_RenderCopy(renderer, backgroundTexture, nullptr, nullptr);
             renderSnake(renderer, snake);
             renderFood(renderer, foodX, foodY);
             renderScore(renderer, font, score);
             renderPause(renderer, font);
-            SDL_RenderPresent(renderer); // Ensure rendering during PAUSED state
+            presentFrame(renderer, capture, frameStats); // Ensure rendering during PAUSED state
 
         } else if (state == MENU) {
             // Render start screen
@@ -857,12 +2272,19 @@ int main(int argc, char* args[]) {
             SDL_RenderClear(renderer);
             SDL_RenderCopy(renderer, backgroundTexture, nullptr, nullptr);
             renderStartScreen(renderer, font);
-            SDL_RenderPresent(renderer); // Ensure rendering during MENU state
+            presentFrame(renderer, capture, frameStats); // Ensure rendering during MENU state
+        }
+
+        // Advance game time by one tick while the game is simulated, so pauses and menus stop every timer exactly
+        if (state == PLAYING || state == LEVEL_UP || state == COUNTDOWN) {
+            gameTime += snakeSpeed;
         }
 
         SDL_Delay(snakeSpeed); // Adjust snake speed based on length
     }
 
+    stopCapture(capture);
+    stopAudio(audio);
     close(window, renderer, font);
     return 0;
 }
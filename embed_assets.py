@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+"""Generate embedded_assets.h so SNAKE_GAME.cpp can load its assets without touching the filesystem.
+
+Usage: python3 embed_assets.py background.bmp background2.bmp apple.bmp banana.bmp stone.bmp font.ttf apple.wav banana.wav levelup.wav collision.wav countdown.wav > embedded_assets.h
+
+Each file is embedded under its base name, which is the name the game looks assets up by.
+Empty files are rejected, since C++ does not allow an empty array initializer.
+"""
+import os
+import re
+import sys
+
+
+def main():
+    assets = []
+    for path in sys.argv[1:]:
+        with open(path, "rb") as f:
+            data = f.read()
+        if not data:
+            sys.exit("embed_assets.py: %s is empty" % path)
+        assets.append((os.path.basename(path), data))
+
+    print("// Generated by embed_assets.py - do not edit")
+    print("#pragma once")
+    print("#include <cstddef>")
+    print()
+    print("struct EmbeddedAsset {")
+    print("    const char* name;")
+    print("    const unsigned char* data;")
+    print("    size_t size;")
+    print("};")
+    print()
+
+    entries = []
+    for name, data in assets:
+        symbol = "asset_" + re.sub(r"\W", "_", name)
+        print("constexpr unsigned char %s[] = {" % symbol)
+        for start in range(0, len(data), 16):
+            print("    " + ", ".join("0x%02x" % b for b in data[start:start + 16]) + ",")
+        print("};")
+        print()
+        entries.append('    { "%s", %s, sizeof(%s) },' % (name, symbol, symbol))
+
+    print("constexpr EmbeddedAsset embeddedAssets[] = {")
+    for entry in entries:
+        print(entry)
+    print("    { nullptr, nullptr, 0 },")
+    print("};")
+
+
+if __name__ == "__main__":
+    main()